@@ -0,0 +1,190 @@
+-- Benchmark suite for the pg_dna hot paths
+--
+-- Run with `make bench` (or psql -X -At -f bench/bench.sql). Output is a
+-- single JSON document on stdout. Variables (psql -v):
+--   sizes    comma-separated table sizes, in kmers / bases  (default 100000,1000000)
+--   probes   number of index lookups per operator and size  (default 200)
+--   k        kmer length used for the kmer tables           (default 21)
+--
+-- Every run uses setseed() so the data sets are identical between runs.
+
+\set ON_ERROR_STOP 1
+\pset format unaligned
+\pset tuples_only on
+\pset pager off
+
+\if :{?sizes}
+\else
+\set sizes '100000,1000000'
+\endif
+\if :{?probes}
+\else
+\set probes 200
+\endif
+\if :{?k}
+\else
+\set k 21
+\endif
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+CREATE TEMP TABLE bench_results (
+    benchmark  text,
+    size       bigint,
+    metric     text,
+    value      double precision,
+    unit       text
+);
+
+-- Wall-clock time of one statement, in milliseconds
+CREATE FUNCTION pg_temp.bench_ms(q text) RETURNS double precision AS $$
+DECLARE
+    t0 timestamptz;
+BEGIN
+    t0 := clock_timestamp();
+    EXECUTE q;
+    RETURN extract(epoch FROM clock_timestamp() - t0) * 1000.0;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Per-probe latency of an indexed lookup; records p50/p95/p99/max
+CREATE FUNCTION pg_temp.bench_lookups(name text, n bigint, q text, probes text[],
+                                      argtype text) RETURNS void AS $$
+DECLARE
+    probe text;
+    t0    timestamptz;
+    lat   double precision[] := '{}';
+    cnt   bigint;
+BEGIN
+    FOREACH probe IN ARRAY probes LOOP
+        t0 := clock_timestamp();
+        EXECUTE format(q, quote_literal(probe) || '::' || argtype) INTO cnt;
+        lat := lat || (extract(epoch FROM clock_timestamp() - t0) * 1000.0)::double precision;
+    END LOOP;
+
+    INSERT INTO bench_results
+    SELECT name, n, m.metric, m.value, 'ms'
+    FROM (SELECT percentile_cont(0.50) WITHIN GROUP (ORDER BY l) AS p50,
+                 percentile_cont(0.95) WITHIN GROUP (ORDER BY l) AS p95,
+                 percentile_cont(0.99) WITHIN GROUP (ORDER BY l) AS p99,
+                 max(l) AS pmax
+          FROM unnest(lat) AS l) AS s,
+         LATERAL (VALUES ('p50', s.p50), ('p95', s.p95),
+                         ('p99', s.p99), ('max', s.pmax)) AS m(metric, value);
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION pg_temp.bench_run(sizes bigint[], nprobes int, kmer_len int) RETURNS void AS $$
+DECLARE
+    n      bigint;
+    ms     double precision;
+    nkmers bigint;
+    probes text[];
+BEGIN
+    PERFORM set_config('max_parallel_workers_per_gather', '0', true);
+
+    FOREACH n IN ARRAY sizes LOOP
+        PERFORM setseed(0.42);
+
+        -- random sequence text, split into 1000-base rows
+        DROP TABLE IF EXISTS bench_text, bench_dna, bench_kmers;
+        CREATE TEMP TABLE bench_text AS
+        SELECT string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '') AS seq
+        FROM generate_series(0, n - 1) AS i
+        GROUP BY i / 1000;
+
+        -- dna_in: text -> dna
+        ms := pg_temp.bench_ms('CREATE TEMP TABLE bench_dna AS SELECT seq::dna AS d FROM bench_text');
+        INSERT INTO bench_results VALUES
+            ('dna_in', n, 'time', ms, 'ms'),
+            ('dna_in', n, 'throughput', n / (ms / 1000.0), 'bases/s');
+
+        -- dna_out: dna -> text
+        ms := pg_temp.bench_ms('SELECT sum(length(d::text)) FROM bench_dna');
+        INSERT INTO bench_results VALUES
+            ('dna_out', n, 'time', ms, 'ms'),
+            ('dna_out', n, 'throughput', n / (ms / 1000.0), 'bases/s');
+
+        -- generate_kmers
+        ms := pg_temp.bench_ms(format(
+            'SELECT count(*) FROM bench_dna, generate_kmers(d, %s)', kmer_len));
+        EXECUTE format(
+            'CREATE TEMP TABLE bench_kmers AS
+             SELECT g.kmer AS k FROM bench_dna, generate_kmers(d, %s) AS g(kmer)', kmer_len);
+        ANALYZE bench_kmers;
+
+        -- k - 1 fewer kmers than bases in each row
+        SELECT count(*) INTO nkmers FROM bench_kmers;
+        INSERT INTO bench_results VALUES
+            ('generate_kmers', n, 'time', ms, 'ms'),
+            ('generate_kmers', n, 'throughput', nkmers / (ms / 1000.0), 'kmers/s');
+
+        -- GROUP BY via hash aggregate, then via sort
+        PERFORM set_config('enable_sort', 'off', true);
+        PERFORM set_config('enable_hashagg', 'on', true);
+        ms := pg_temp.bench_ms('SELECT count(*) FROM (SELECT k, count(*) FROM bench_kmers GROUP BY k) s');
+        INSERT INTO bench_results VALUES ('group_by_hash', n, 'time', ms, 'ms');
+
+        PERFORM set_config('enable_sort', 'on', true);
+        PERFORM set_config('enable_hashagg', 'off', true);
+        ms := pg_temp.bench_ms('SELECT count(*) FROM (SELECT k, count(*) FROM bench_kmers GROUP BY k) s');
+        INSERT INTO bench_results VALUES ('group_by_sort', n, 'time', ms, 'ms');
+        PERFORM set_config('enable_hashagg', 'on', true);
+
+        -- index builds
+        ms := pg_temp.bench_ms('CREATE INDEX bench_kmers_btree ON bench_kmers USING btree (k)');
+        INSERT INTO bench_results VALUES ('index_build_btree', n, 'time', ms, 'ms');
+        DROP INDEX bench_kmers_btree;
+
+        ms := pg_temp.bench_ms('CREATE INDEX bench_kmers_spgist ON bench_kmers USING spgist (k)');
+        INSERT INTO bench_results VALUES ('index_build_spgist', n, 'time', ms, 'ms');
+        INSERT INTO bench_results VALUES
+            ('index_size_spgist', n, 'size',
+             pg_relation_size('bench_kmers_spgist'), 'bytes'),
+            ('table_size', n, 'size', pg_relation_size('bench_kmers'), 'bytes');
+
+        -- SP-GiST lookup latencies
+        PERFORM set_config('enable_seqscan', 'off', true);
+        PERFORM set_config('enable_bitmapscan', 'off', true);
+
+        SELECT array_agg(k::text) INTO probes
+        FROM (SELECT k FROM bench_kmers ORDER BY random() LIMIT nprobes) s;
+
+        PERFORM pg_temp.bench_lookups('spgist_eq', n,
+            'SELECT count(*) FROM bench_kmers WHERE k = %s', probes, 'kmer');
+
+        PERFORM pg_temp.bench_lookups('spgist_prefix', n,
+            'SELECT count(*) FROM bench_kmers WHERE k ^@ %s',
+            ARRAY(SELECT left(p, 6) FROM unnest(probes) AS p), 'kmer');
+
+        PERFORM pg_temp.bench_lookups('spgist_pattern', n,
+            'SELECT count(*) FROM bench_kmers WHERE k <@ %s',
+            ARRAY(SELECT left(p, 4) || repeat('N', kmer_len - 8) || right(p, 4)
+                  FROM unnest(probes) AS p), 'qkmer');
+
+        PERFORM set_config('enable_seqscan', 'on', true);
+        PERFORM set_config('enable_bitmapscan', 'on', true);
+    END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT pg_temp.bench_run(string_to_array(:'sizes', ',')::bigint[], :probes, :k) \g /dev/null
+
+SELECT json_build_object(
+           'server_version', current_setting('server_version'),
+           'extension_version', (SELECT extversion FROM pg_extension
+                                 WHERE extname = 'pg_dna'),
+           'k', :k,
+           'probes', :probes,
+           'started_at', now(),
+           'results', json_agg(json_build_object(
+                          'benchmark', benchmark,
+                          'size', size,
+                          'metric', metric,
+                          'value', round(value::numeric, 3),
+                          'unit', unit)
+                      ORDER BY size, benchmark, metric))
+FROM bench_results;
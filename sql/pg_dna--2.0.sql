@@ -0,0 +1,734 @@
+-- SQL script for pg_dna extension version 2.0
+--  Create a shell type so that we can reference it in function signatures
+CREATE TYPE dna;
+--  Parallel safety / cost notes:
+--  functions not listed below are PARALLEL SAFE pure functions of their
+--  arguments (no table access, no GUCs, no backend-local state); the
+--  aggregate support functions keep their state in the aggregate context,
+--  and the ANALYZE and selectivity functions only read statistics.
+--  The exceptions:
+--    pg_dna_scan_stats   PARALLEL RESTRICTED: reads and resets counters local
+--                        to the calling backend, which a worker cannot see
+--    dna_lo_create,      PARALLEL UNSAFE: write large objects, and parallel
+--    dna_lo_append       mode allows no writes
+--    other dna_lo_*      PARALLEL RESTRICTED: read large objects through
+--                        descriptors opened in the leader's transaction
+--    spg_kmer_inner_consistent, spg_kmer_leaf_consistent
+--                        PARALLEL SAFE, but not pure: they read the
+--                        pg_dna.track_scan_stats GUC (which workers inherit)
+--                        and add to backend-local scan counters. Counts made
+--                        in a parallel worker stay in that worker, so
+--                        pg_dna_scan_stats() only reports the SP-GiST scans
+--                        run by the leader itself
+--  COST is raised above the C default (1) only for the functions that are
+--  linear in the length of a dna value; a kmer has at most 31 bases and a
+--  qkmer at most 32 positions, so their functions keep the default.
+--  Declare the input function
+CREATE FUNCTION dna_in(cstring) RETURNS dna AS 'pg_dna',
+'dna_in' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+--  Declare the output function
+CREATE FUNCTION dna_out(dna) RETURNS cstring AS 'pg_dna',
+'dna_out' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+--  Binary I/O: length + 2-bit packed bytes
+CREATE FUNCTION dna_recv(internal) RETURNS dna AS 'pg_dna',
+'dna_recv' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+CREATE FUNCTION dna_send(dna) RETURNS bytea AS 'pg_dna',
+'dna_send' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+--  Complete the DNA type definition
+CREATE TYPE dna (
+    INPUT = dna_in,
+    OUTPUT = dna_out,
+    RECEIVE = dna_recv,
+    SEND = dna_send,
+    INTERNALLENGTH = VARIABLE,
+    -- 2-bit packed bases barely compress: store large values out of line
+    -- uncompressed, so dna_get/dna_substr only read the chunks they need
+    STORAGE = EXTERNAL
+);
+--  Utility: length of a DNA sequence
+CREATE FUNCTION dna_length(dna) RETURNS integer AS 'pg_dna',
+'dna_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+COMMENT ON TYPE dna IS 'DNA sequence type stored like text (A/C/G/T only)';
+-- . Polymorphic-style length(dna) wrapper, to match length(text)
+CREATE FUNCTION length(dna) RETURNS integer AS 'pg_dna',
+'dna_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- Utility: get nucleotide at specific position (1-based index)
+CREATE FUNCTION dna_get(dna, integer) RETURNS text AS 'pg_dna',
+'dna_get' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- Utility: region [start, start + len) of a sequence (1-based, as substr)
+CREATE FUNCTION dna_substr(dna, integer, integer) RETURNS dna AS 'pg_dna',
+'dna_substr' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION substr(dna, integer, integer) RETURNS dna AS 'pg_dna',
+'dna_substr' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- kmer type
+-- 
+CREATE TYPE kmer;
+-- I/O functions
+CREATE FUNCTION kmer_in(cstring) RETURNS kmer AS 'pg_dna',
+'kmer_in' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION kmer_out(kmer) RETURNS cstring AS 'pg_dna',
+'kmer_out' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION kmer_recv(internal) RETURNS kmer AS 'pg_dna',
+'kmer_recv' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION kmer_send(kmer) RETURNS bytea AS 'pg_dna',
+'kmer_send' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- ANALYZE: the standard statistics plus per-position base frequencies
+CREATE FUNCTION kmer_typanalyze(internal) RETURNS boolean AS 'pg_dna',
+'kmer_typanalyze' LANGUAGE C STRICT PARALLEL SAFE;
+--  Complete kmer type definition
+--  Fixed 8-byte word passed by value: 2-bit bases + terminator bit (k <= 31)
+CREATE TYPE kmer (
+    INPUT = kmer_in,
+    OUTPUT = kmer_out,
+    RECEIVE = kmer_recv,
+    SEND = kmer_send,
+    ANALYZE = kmer_typanalyze,
+    INTERNALLENGTH = 8,
+    PASSEDBYVALUE,
+    ALIGNMENT = double,
+    STORAGE = PLAIN
+);
+--  length(kmer)
+CREATE FUNCTION kmer_length(kmer) RETURNS integer AS 'pg_dna',
+'kmer_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION length(kmer) RETURNS integer AS 'pg_dna',
+'kmer_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- qkmer type
+CREATE TYPE qkmer;
+-- I/O functions
+CREATE FUNCTION qkmer_in(cstring) RETURNS qkmer AS 'pg_dna',
+'qkmer_in' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION qkmer_out(qkmer) RETURNS cstring AS 'pg_dna',
+'qkmer_out' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION qkmer_recv(internal) RETURNS qkmer AS 'pg_dna',
+'qkmer_recv' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION qkmer_send(qkmer) RETURNS bytea AS 'pg_dna',
+'qkmer_send' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- Complete qkmer type definition
+CREATE TYPE qkmer (
+    INPUT = qkmer_in,
+    OUTPUT = qkmer_out,
+    RECEIVE = qkmer_recv,
+    SEND = qkmer_send,
+    INTERNALLENGTH = VARIABLE,
+    STORAGE = EXTENDED
+);
+-- length(qkmer)
+CREATE FUNCTION qkmer_length(qkmer) RETURNS integer AS 'pg_dna',
+'qkmer_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION length(qkmer) RETURNS integer AS 'pg_dna',
+'qkmer_length' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+-- kmer and qkmer operators
+-- Functions
+CREATE FUNCTION kmer_eq(kmer, kmer) RETURNS boolean AS 'pg_dna',
+'kmer_eq' LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+CREATE FUNCTION kmer_starts_with(kmer, kmer) RETURNS boolean AS 'pg_dna',
+'kmer_starts_with' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+CREATE FUNCTION qkmer_contains(qkmer, kmer) RETURNS boolean AS 'pg_dna',
+'qkmer_contains' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Assignment-friendly aliases (argument order matches the project PDF)
+CREATE FUNCTION equals(kmer, kmer) RETURNS boolean AS 'pg_dna',
+'kmer_eq' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- PDF uses starts_with(prefix, value); internal function expects (value, prefix)
+CREATE FUNCTION starts_with(kmer, kmer) RETURNS boolean AS $$
+    SELECT kmer_starts_with($2, $1);
+$$ LANGUAGE SQL IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION contains(qkmer, kmer) RETURNS boolean AS $$
+    SELECT qkmer_contains($1, $2);
+$$ LANGUAGE SQL IMMUTABLE STRICT PARALLEL SAFE;
+-- generate_kmers(dna, k [, canonical]) -> SETOF kmer
+-- with canonical, each kmer is replaced by kmer_canonical(kmer)
+CREATE FUNCTION generate_kmers(seq dna, k integer, canonical boolean DEFAULT false)
+RETURNS SETOF kmer AS 'pg_dna', 'generate_kmers'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+-- generate_kmers_positions(dna, k [, both_strands]) -> (kmer, pos, strand)
+-- Materialize-mode variant that also reports the 1-based start position and
+-- the strand ('+', or '-' for reverse complements when both_strands is true)
+CREATE FUNCTION generate_kmers_positions(seq dna, k integer,
+                                         both_strands boolean DEFAULT false,
+                                         OUT kmer kmer, OUT pos integer,
+                                         OUT strand "char")
+RETURNS SETOF record AS 'pg_dna', 'generate_kmers_positions'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+-- Operators
+
+
+-- equality: = on kmer
+CREATE OPERATOR = (
+    LEFTARG = kmer,
+    RIGHTARG = kmer,
+    PROCEDURE = kmer_eq,
+    COMMUTATOR = '=',
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES,
+    MERGES
+);
+-- inequality: <> on kmer
+CREATE FUNCTION kmer_ne(kmer, kmer) RETURNS boolean AS 'pg_dna',
+'kmer_ne' LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR <> (
+    LEFTARG = kmer,
+    RIGHTARG = kmer,
+    PROCEDURE = kmer_ne,
+    COMMUTATOR = '<>',
+    NEGATOR = '=',
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+-- selectivity of ^@, <@ and @> from the kmer statistics
+CREATE FUNCTION kmer_prefix_sel(internal, oid, internal, integer)
+RETURNS float8
+AS 'pg_dna', 'kmer_prefix_sel'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_prefix_joinsel(internal, oid, internal, smallint, internal)
+RETURNS float8
+AS 'pg_dna', 'kmer_prefix_joinsel'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION qkmer_contains_sel(internal, oid, internal, integer)
+RETURNS float8
+AS 'pg_dna', 'qkmer_contains_sel'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_contained_sel(internal, oid, internal, integer)
+RETURNS float8
+AS 'pg_dna', 'kmer_contained_sel'
+LANGUAGE C STABLE STRICT PARALLEL SAFE;
+
+-- prefix: ^@
+CREATE OPERATOR ^@ (
+    LEFTARG   = kmer,
+    RIGHTARG  = kmer,
+    PROCEDURE = kmer_starts_with,
+    RESTRICT  = kmer_prefix_sel,
+    JOIN      = kmer_prefix_joinsel
+);
+
+
+
+-- pattern: qkmer @> kmer
+CREATE OPERATOR @> (
+    LEFTARG = qkmer,
+    RIGHTARG = kmer,
+    PROCEDURE = qkmer_contains,
+    RESTRICT = qkmer_contains_sel,
+    JOIN = matchingjoinsel
+);
+
+CREATE FUNCTION kmer_contained_by(kmer, qkmer) RETURNS boolean AS 'pg_dna',
+'kmer_contained_by' LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR <@ (
+    LEFTARG = kmer,
+    RIGHTARG = qkmer,
+    PROCEDURE = kmer_contained_by,
+    COMMUTATOR = '@>',
+    RESTRICT = kmer_contained_sel,
+    JOIN = matchingjoinsel
+);
+
+
+
+-- SP-GiST support functions for kmer
+CREATE FUNCTION spg_kmer_config(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME', 'spg_kmer_config'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION spg_kmer_choose(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME', 'spg_kmer_choose'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION spg_kmer_picksplit(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME', 'spg_kmer_picksplit'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION spg_kmer_inner_consistent(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME', 'spg_kmer_inner_consistent'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION spg_kmer_leaf_consistent(internal, internal)
+    RETURNS void
+AS 'MODULE_PATHNAME', 'spg_kmer_leaf_consistent'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- SP-GiST scan instrumentation: counters are collected only while
+-- pg_dna.track_scan_stats is on; pass true to reset them after reading.
+-- Scans run inside parallel workers are not counted.
+CREATE FUNCTION pg_dna_scan_stats(reset boolean DEFAULT false,
+                                  OUT inner_visited bigint,
+                                  OUT nodes_descended bigint,
+                                  OUT nodes_pruned bigint,
+                                  OUT leaves_tested bigint,
+                                  OUT leaves_matched bigint)
+    RETURNS record
+AS 'MODULE_PATHNAME', 'pg_dna_scan_stats'
+LANGUAGE C VOLATILE STRICT PARALLEL RESTRICTED;
+
+-- Hash function for GROUP BY and DISTINCT
+CREATE FUNCTION kmer_hash(kmer)
+RETURNS integer
+AS 'pg_dna', 'kmer_hash'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+-- Seeded 64-bit hash, for hash partitioning
+CREATE FUNCTION kmer_hash_extended(kmer, bigint)
+RETURNS bigint
+AS 'pg_dna', 'kmer_hash_extended'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR CLASS kmer_hash_ops
+DEFAULT FOR TYPE kmer USING hash AS
+    OPERATOR 1 = (kmer, kmer),
+    FUNCTION 1 kmer_hash(kmer),
+    FUNCTION 2 kmer_hash_extended(kmer, bigint);
+
+
+-- Comparing function and comparaison operators for the b-tree for ordering
+
+CREATE FUNCTION kmer_cmp(kmer, kmer)
+RETURNS integer
+AS 'pg_dna', 'kmer_cmp'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+-- Sort support: native comparator + abbreviated keys for tuplesort
+CREATE FUNCTION kmer_sortsupport(internal)
+RETURNS void
+AS 'pg_dna', 'kmer_sortsupport'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_lt(kmer, kmer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_lt'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR < (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_lt,
+    COMMUTATOR = '>',
+    NEGATOR = '>=',
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE FUNCTION kmer_le(kmer, kmer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_le'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR <= (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_le,
+    COMMUTATOR = '>=',
+    NEGATOR = '>',
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE FUNCTION kmer_gt(kmer, kmer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_gt'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR > (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_gt,
+    COMMUTATOR = '<',
+    NEGATOR = '<=',
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE FUNCTION kmer_ge(kmer, kmer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_ge'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR >= (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_ge,
+    COMMUTATOR = '<=',
+    NEGATOR = '<',
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR CLASS kmer_btree_ops
+DEFAULT FOR TYPE kmer USING btree AS
+    OPERATOR 1  <  (kmer, kmer),
+    OPERATOR 2  <= (kmer, kmer),
+    OPERATOR 3  =  (kmer, kmer),
+    OPERATOR 4  >= (kmer, kmer),
+    OPERATOR 5  >  (kmer, kmer),
+    FUNCTION 1 kmer_cmp(kmer, kmer),
+    FUNCTION 2 kmer_sortsupport(internal);
+
+
+-- Hamming distance between kmers; the shorter kmer counts one mismatch
+-- per missing base
+
+CREATE FUNCTION kmer_hamming(kmer, kmer)
+RETURNS integer
+AS 'pg_dna', 'kmer_hamming'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR <-> (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_hamming,
+    COMMUTATOR = '<->'
+);
+
+-- true when the kmers are within d mismatches of each other
+CREATE FUNCTION kmer_within(kmer, kmer, integer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_within'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+
+-- Strands: reverse complement, canonical form (the smaller of the kmer and
+-- its reverse complement) and ~= (same kmer on either strand)
+
+CREATE FUNCTION kmer_revcomp(kmer)
+RETURNS kmer
+AS 'pg_dna', 'kmer_revcomp'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE FUNCTION kmer_canonical(kmer)
+RETURNS kmer
+AS 'pg_dna', 'kmer_canonical'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE FUNCTION kmer_canonical_eq(kmer, kmer)
+RETURNS boolean
+AS 'pg_dna', 'kmer_canonical_eq'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE OPERATOR ~= (
+    LEFTARG = kmer, RIGHTARG = kmer,
+    PROCEDURE = kmer_canonical_eq,
+    COMMUTATOR = '~=',
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel,
+    HASHES
+);
+
+CREATE FUNCTION kmer_canonical_hash(kmer)
+RETURNS integer
+AS 'pg_dna', 'kmer_canonical_hash'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+CREATE FUNCTION kmer_canonical_hash_extended(kmer, bigint)
+RETURNS bigint
+AS 'pg_dna', 'kmer_canonical_hash_extended'
+LANGUAGE C IMMUTABLE STRICT LEAKPROOF PARALLEL SAFE;
+
+-- hash index / hash join on ~=; for a btree, index kmer_canonical(col)
+CREATE OPERATOR CLASS kmer_canonical_hash_ops
+FOR TYPE kmer USING hash AS
+    OPERATOR 1 ~= (kmer, kmer),
+    FUNCTION 1 kmer_canonical_hash(kmer),
+    FUNCTION 2 kmer_canonical_hash_extended(kmer, bigint);
+
+
+-- framework sp-gist
+
+CREATE OPERATOR CLASS kmer_spgist_ops
+DEFAULT FOR TYPE kmer USING spgist AS
+    STORAGE kmer,
+
+    -- 1, 2, 4, 5 range operators (btree strategy numbers)
+    -- 3  = operator
+    -- 6  ~= operator (either strand)
+    -- 28 ^@ operator
+    -- 10 operator  @>
+    -- 15 <-> ordering (ORDER BY k <-> query LIMIT n)
+    OPERATOR  1  <  (kmer, kmer),
+    OPERATOR  2  <= (kmer, kmer),
+    OPERATOR  3  =  (kmer, kmer),
+    OPERATOR  4  >= (kmer, kmer),
+    OPERATOR  5  >  (kmer, kmer),
+    OPERATOR  6  ~= (kmer, kmer),
+    OPERATOR 28  ^@ (kmer, kmer),
+    OPERATOR 10 <@ (kmer, qkmer),
+    OPERATOR 15 <-> (kmer, kmer) FOR ORDER BY pg_catalog.integer_ops,
+    FUNCTION 1  spg_kmer_config           (internal, internal),
+    FUNCTION 2  spg_kmer_choose           (internal, internal),
+    FUNCTION 3  spg_kmer_picksplit        (internal, internal),
+    FUNCTION 4  spg_kmer_inner_consistent (internal, internal),
+    FUNCTION 5  spg_kmer_leaf_consistent  (internal, internal);
+
+
+-- dna containment: dna @> kmer, dna @> qkmer
+
+CREATE FUNCTION dna_contains_kmer(dna, kmer)
+RETURNS boolean
+AS 'pg_dna', 'dna_contains_kmer'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE OPERATOR @> (
+    LEFTARG = dna, RIGHTARG = kmer,
+    PROCEDURE = dna_contains_kmer,
+    RESTRICT = contsel,
+    JOIN = contjoinsel
+);
+
+CREATE FUNCTION dna_contains_qkmer(dna, qkmer)
+RETURNS boolean
+AS 'pg_dna', 'dna_contains_qkmer'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE OPERATOR @> (
+    LEFTARG = dna, RIGHTARG = qkmer,
+    PROCEDURE = dna_contains_qkmer,
+    RESTRICT = contsel,
+    JOIN = contjoinsel
+);
+
+
+-- substring search on dna (shift-or on the packed bases)
+--   dna_contains(seq, pattern)  -> boolean
+--   dna_position(seq, pattern)  -> 1-based start of the first match, 0 if none
+--   dna_find_all(seq, pattern)  -> 1-based starts of all (overlapping) matches
+-- pattern is a dna or an IUPAC qkmer
+
+CREATE FUNCTION dna_contains(dna, dna)
+RETURNS boolean
+AS 'pg_dna', 'dna_contains_dna'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE FUNCTION dna_contains(dna, qkmer)
+RETURNS boolean
+AS 'pg_dna', 'dna_contains_qkmer'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE FUNCTION dna_position(dna, dna)
+RETURNS integer
+AS 'pg_dna', 'dna_position_dna'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE FUNCTION dna_position(dna, qkmer)
+RETURNS integer
+AS 'pg_dna', 'dna_position_qkmer'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE FUNCTION dna_find_all(dna, dna)
+RETURNS SETOF integer
+AS 'pg_dna', 'dna_find_all_dna'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+CREATE FUNCTION dna_find_all(dna, qkmer)
+RETURNS SETOF integer
+AS 'pg_dna', 'dna_find_all_qkmer'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE COST 10;
+
+-- chunked storage: a sequence in a large object, with no 1 GB limit
+--   SELECT dna_lo_create();                -> oid of an empty sequence
+--   SELECT dna_lo_append(lo, seq);         -> new length; load piece by piece
+-- the readers below stream it chunk by chunk in bounded memory
+
+CREATE FUNCTION dna_lo_create()
+RETURNS oid
+AS 'pg_dna', 'dna_lo_create'
+LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
+
+CREATE FUNCTION dna_lo_append(oid, dna)
+RETURNS bigint
+AS 'pg_dna', 'dna_lo_append'
+LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE COST 10;
+
+CREATE FUNCTION dna_lo_length(oid)
+RETURNS bigint
+AS 'pg_dna', 'dna_lo_length'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED;
+
+CREATE FUNCTION dna_lo_substr(oid, bigint, integer)
+RETURNS dna
+AS 'pg_dna', 'dna_lo_substr'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+CREATE FUNCTION dna_lo_kmers(lo oid, k integer, OUT kmer kmer, OUT pos bigint)
+RETURNS SETOF record
+AS 'pg_dna', 'dna_lo_kmers'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+CREATE FUNCTION dna_lo_position(oid, dna)
+RETURNS bigint
+AS 'pg_dna', 'dna_lo_position_dna'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+CREATE FUNCTION dna_lo_position(oid, qkmer)
+RETURNS bigint
+AS 'pg_dna', 'dna_lo_position_qkmer'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+CREATE FUNCTION dna_lo_find_all(oid, dna)
+RETURNS SETOF bigint
+AS 'pg_dna', 'dna_lo_find_all_dna'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+CREATE FUNCTION dna_lo_find_all(oid, qkmer)
+RETURNS SETOF bigint
+AS 'pg_dna', 'dna_lo_find_all_qkmer'
+LANGUAGE C STABLE STRICT PARALLEL RESTRICTED COST 10;
+
+-- framework gin: the kmers of each sequence are the keys
+--   CREATE INDEX ... USING gin (seq dna_gin_ops (k = 12, minimizer_window = 1))
+
+CREATE FUNCTION dna_gin_options(internal)
+RETURNS void
+AS 'pg_dna', 'dna_gin_options'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION dna_gin_extract_value(dna, internal, internal)
+RETURNS internal
+AS 'pg_dna', 'dna_gin_extract_value'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION dna_gin_extract_query(dna, internal, int2, internal, internal, internal, internal)
+RETURNS internal
+AS 'pg_dna', 'dna_gin_extract_query'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION dna_gin_consistent(internal, int2, dna, int4, internal, internal, internal, internal)
+RETURNS boolean
+AS 'pg_dna', 'dna_gin_consistent'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION dna_gin_triconsistent(internal, int2, dna, int4, internal, internal, internal)
+RETURNS "char"
+AS 'pg_dna', 'dna_gin_triconsistent'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION dna_gin_compare_partial(kmer, kmer, int2, internal)
+RETURNS integer
+AS 'pg_dna', 'dna_gin_compare_partial'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR CLASS dna_gin_ops
+DEFAULT FOR TYPE dna USING gin AS
+    STORAGE kmer,
+
+    -- 7 dna @> kmer
+    -- 8 dna @> qkmer
+    OPERATOR 7  @> (dna, kmer),
+    OPERATOR 8  @> (dna, qkmer),
+    FUNCTION 1  kmer_cmp (kmer, kmer),
+    FUNCTION 2  dna_gin_extract_value (dna, internal, internal),
+    FUNCTION 3  dna_gin_extract_query (dna, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4  dna_gin_consistent (internal, int2, dna, int4, internal, internal, internal, internal),
+    FUNCTION 5  dna_gin_compare_partial (kmer, kmer, int2, internal),
+    FUNCTION 6  dna_gin_triconsistent (internal, int2, dna, int4, internal, internal, internal),
+    FUNCTION 7  dna_gin_options (internal);
+
+
+-- kmer_counts(seq, k [, bin, bins]) -> kmer_count[]: kmer frequencies over
+-- all rows, sorted by kmer, counted in one open-addressing table per
+-- aggregate (partial counts are combined across parallel workers).
+-- With bins > 1 only the kmers of one hash bin are counted, e.g.
+--   SELECT c.* FROM generate_series(0, 15) AS bin,
+--          LATERAL (SELECT kmer_counts(seq, 31, bin, 16) AS counts FROM reads) AS s,
+--          unnest(s.counts) AS c;
+CREATE TYPE kmer_count AS (kmer kmer, count bigint);
+
+CREATE FUNCTION kmer_counts_accum(internal, dna, integer)
+RETURNS internal
+AS 'pg_dna', 'kmer_counts_accum'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_counts_accum(internal, dna, integer, integer, integer)
+RETURNS internal
+AS 'pg_dna', 'kmer_counts_accum'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_counts_combine(internal, internal)
+RETURNS internal
+AS 'pg_dna', 'kmer_counts_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_counts_serialize(internal)
+RETURNS bytea
+AS 'pg_dna', 'kmer_counts_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_counts_deserialize(bytea, internal)
+RETURNS internal
+AS 'pg_dna', 'kmer_counts_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_counts_final(internal)
+RETURNS kmer_count[]
+AS 'pg_dna', 'kmer_counts_final'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE kmer_counts(seq dna, k integer) (
+    SFUNC = kmer_counts_accum,
+    STYPE = internal,
+    SSPACE = 16384,
+    FINALFUNC = kmer_counts_final,
+    COMBINEFUNC = kmer_counts_combine,
+    SERIALFUNC = kmer_counts_serialize,
+    DESERIALFUNC = kmer_counts_deserialize,
+    PARALLEL = SAFE
+);
+
+CREATE AGGREGATE kmer_counts(seq dna, k integer, bin integer, bins integer) (
+    SFUNC = kmer_counts_accum,
+    STYPE = internal,
+    SSPACE = 16384,
+    FINALFUNC = kmer_counts_final,
+    COMBINEFUNC = kmer_counts_combine,
+    SERIALFUNC = kmer_counts_serialize,
+    DESERIALFUNC = kmer_counts_deserialize,
+    PARALLEL = SAFE
+);
+
+
+-- kmer_spectrum(seq, k) -> bytea: dense kmer counts for k <= 12, one uint32
+-- counter per possible kmer (4^k of them, in kmer order, after k itself;
+-- network byte order). kmer_spectrum_counts() unnests the non-zero ones.
+CREATE FUNCTION kmer_spectrum_accum(internal, dna, integer)
+RETURNS internal
+AS 'pg_dna', 'kmer_spectrum_accum'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_combine(internal, internal)
+RETURNS internal
+AS 'pg_dna', 'kmer_spectrum_combine'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- also the final function: the spectrum is the serialized state
+CREATE FUNCTION kmer_spectrum_serialize(internal)
+RETURNS bytea
+AS 'pg_dna', 'kmer_spectrum_serialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION kmer_spectrum_deserialize(bytea, internal)
+RETURNS internal
+AS 'pg_dna', 'kmer_spectrum_deserialize'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE kmer_spectrum(seq dna, k integer) (
+    SFUNC = kmer_spectrum_accum,
+    STYPE = internal,
+    SSPACE = 4194304,
+    FINALFUNC = kmer_spectrum_serialize,
+    COMBINEFUNC = kmer_spectrum_combine,
+    SERIALFUNC = kmer_spectrum_serialize,
+    DESERIALFUNC = kmer_spectrum_deserialize,
+    PARALLEL = SAFE
+);
+
+CREATE FUNCTION kmer_spectrum_counts(spectrum bytea,
+                                     OUT kmer kmer, OUT count bigint)
+RETURNS SETOF record
+AS 'pg_dna', 'kmer_spectrum_counts'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
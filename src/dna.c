@@ -3,12 +3,14 @@
 #include "varatt.h"
 #endif
 #include "fmgr.h"
+#include "libpq/pqformat.h"
 #include "utils/varlena.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "dna.h"
+#include "dna_codec.h"
+#include "spgist_kmer.h"
 
-#include <ctype.h>
 #include <string.h>
 
 PG_MODULE_MAGIC;
@@ -17,39 +19,21 @@ PG_FUNCTION_INFO_V1(dna_in);
 PG_FUNCTION_INFO_V1(dna_out);
 PG_FUNCTION_INFO_V1(dna_length);
 PG_FUNCTION_INFO_V1(dna_get);
+PG_FUNCTION_INFO_V1(dna_substr);
+PG_FUNCTION_INFO_V1(dna_recv);
+PG_FUNCTION_INFO_V1(dna_send);
 
+void _PG_init(void);
 
-/*
- * Encode one base (char) into 2 bits (0..3).
- * Accepts both upper and lowercase A/C/G/T.
- * Raises a PostgreSQL ERROR on invalid character.
- */
-static unsigned char
-encode_base(char c)
+// Module load: pick the encode/decode kernels for this CPU, define GUCs
+void
+_PG_init(void)
 {
-    unsigned char uc;
-
-    uc = (unsigned char) c;
-    uc = (unsigned char) toupper(uc);
-
-    switch (uc)
-    {
-        case 'A':
-            return 0;
-        case 'C':
-            return 1;
-        case 'G':
-            return 2;
-        case 'T':
-            return 3;
-        default:
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
-                     errmsg("invalid DNA base: '%c' (allowed: A,C,G,T only)", c)));
-            return 0;
-    }
+    dna_codec_init();
+    spg_kmer_init();
 }
 
+
 /*
  * Decode 2 bits (0..3) back into a base character.
  * This should never see values outside 0..3 if the data is consistent.
@@ -69,7 +53,7 @@ decode_base(unsigned char b)
  *  - length is not absurdly large
  * Raises ERROR if something looks corrupted 
  */
-static void
+void
 check_dna_consistency(const Dna *dna)
 {
     Size size;
@@ -150,29 +134,19 @@ dna_in(PG_FUNCTION_ARGS)
     // Store logical length in bases
     result->length = n;
 
-    // Initialize packed bytes to zero
-    if (packed_bytes > 0)
-        memset(result->data, 0, packed_bytes);
-
     /*
      * Pack bases: 4 bases per byte, big-endian inside each byte:
      *   bits 7..6 => base 0
      *   bits 5..4 => base 1
      *   bits 3..2 => base 2
      *   bits 1..0 => base 3
+     * Validation and packing run block-wise in dna_encode (SIMD when available).
      */
-    for (i = 0; i < n; i++)
+    if (!dna_encode(input, n, result->data, &i))
     {
-        unsigned char b;
-        uint32        byte_index;
-        uint32        shift;
-
-        b = encode_base(input[i]);
-
-        byte_index = i / 4;
-        shift      = (3 - (i % 4)) * 2;
-
-        result->data[byte_index] |= (unsigned char) (b << shift);
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                 errmsg("invalid DNA base: '%c' (allowed: A,C,G,T only)", input[i])));
     }
 
     PG_RETURN_POINTER(result);
@@ -188,7 +162,6 @@ dna_out(PG_FUNCTION_ARGS)
     Datum  arg;
     Dna   *dna;
     uint32 n;
-    uint32 i;
     char  *buf;
 
     
@@ -206,40 +179,143 @@ dna_out(PG_FUNCTION_ARGS)
 
     buf = (char *) palloc(n + 1);
 
-    for (i = 0; i < n; i++)
+    dna_decode(dna->data, n, buf);
+
+    buf[n] = '\0';
+
+    PG_RETURN_CSTRING(buf);
+}
+
+
+//Binary input: dna_recv(internal) to dna
+// wire format: uint32 length, then the packed bytes as stored
+
+
+Datum
+dna_recv(PG_FUNCTION_ARGS)
+{
+    StringInfo buf;
+    uint32     n;
+    uint32     packed_bytes;
+    Size       size;
+    Dna       *result;
+
+    buf = (StringInfo) PG_GETARG_POINTER(0);
+    n   = (uint32) pq_getmsgint(buf, 4);
+
+    if (n > DNA_MAX_LENGTH)
     {
-        uint32 byte_index;
-        uint32 shift;
-        unsigned char packed;
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("DNA sequence too long (%u bases, max is %u)",
+                        n, DNA_MAX_LENGTH)));
+    }
 
-        byte_index = i / 4;
-        shift      = (3 - (i % 4)) * 2;
+    packed_bytes = DNA_PACKED_BYTES(n);
 
-        packed = (unsigned char) ((dna->data[byte_index] >> shift) & 0x03);
-        buf[i] = decode_base(packed);
+    if ((uint32) (buf->len - buf->cursor) != packed_bytes)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("invalid dna binary data: expected %u packed bytes for %u bases, got %d",
+                        packed_bytes, n, buf->len - buf->cursor)));
     }
 
-    buf[n] = '\0';
+    size   = offsetof(Dna, data) + packed_bytes;
+    result = (Dna *) palloc(size);
+    SET_VARSIZE(result, size);
+    result->length = n;
 
-    PG_RETURN_CSTRING(buf);
+    pq_copymsgbytes(buf, (char *) result->data, (int) packed_bytes);
+
+    // unused bits of the last byte must be zero so equal sequences compare equal
+    if ((n % 4) != 0 &&
+        (result->data[packed_bytes - 1] & (0xFF >> (2 * (n % 4)))) != 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("invalid dna binary data: padding bits are not zero")));
+    }
+
+    PG_RETURN_POINTER(result);
 }
 
 
-//dna_length(dna) to integer
+//Binary output: dna_send(dna) to bytea
 
 
 Datum
-dna_length(PG_FUNCTION_ARGS)
+dna_send(PG_FUNCTION_ARGS)
 {
-    Datum  arg;
-    Dna   *dna;
-
-    arg = PG_GETARG_DATUM(0);
-    dna = (Dna *) PG_DETOAST_DATUM(arg);
+    Dna           *dna;
+    StringInfoData buf;
 
+    dna = (Dna *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
     check_dna_consistency(dna);
 
-    PG_RETURN_INT32((int32) dna->length);
+    pq_begintypsend(&buf);
+    pq_sendint32(&buf, dna->length);
+    pq_sendbytes(&buf, (char *) dna->data, (int) DNA_PACKED_BYTES(dna->length));
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+
+/*
+ * Random access without detoasting the whole value.
+ * Slices are offsets into the data after the varlena header, so the
+ * length field is at 0 and the packed bytes start right after it. With
+ * STORAGE EXTERNAL (the default for dna) a slice only reads the toast
+ * chunks that cover it; compressed values are decompressed up to it.
+ */
+#define DNA_SLICE_DATA_OFFSET  (offsetof(Dna, data) - VARHDRSZ)
+
+uint32
+dna_fetch_length(Datum arg)
+{
+    struct varlena *slice;
+    uint32          n;
+
+    slice = PG_DETOAST_DATUM_SLICE(arg, 0, sizeof(uint32));
+
+    if (VARSIZE_ANY_EXHDR(slice) < sizeof(uint32))
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("dna value is corrupted: missing length")));
+
+    memcpy(&n, VARDATA_ANY(slice), sizeof(uint32));
+
+    if (n > DNA_MAX_LENGTH)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("dna value has unreasonable length: %u", n)));
+    return n;
+}
+
+// packed bytes [first, first + count) of the value, at VARDATA_ANY(result)
+struct varlena *
+dna_fetch_packed(Datum arg, uint32 first, uint32 count)
+{
+    struct varlena *slice;
+
+    slice = PG_DETOAST_DATUM_SLICE(arg, DNA_SLICE_DATA_OFFSET + first, count);
+
+    if (VARSIZE_ANY_EXHDR(slice) < count)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("dna value is corrupted: packed data too short")));
+
+    return slice;
+}
+
+
+//dna_length(dna) to integer
+
+
+Datum
+dna_length(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_INT32((int32) dna_fetch_length(PG_GETARG_DATUM(0)));
 }
 
 
@@ -250,23 +326,18 @@ Datum
 dna_get(PG_FUNCTION_ARGS)
 {
     Datum  arg;
-    Dna   *dna;
     int32  idx;
     uint32 n;
     uint32 i;
-    uint32 byte_index;
     uint32 shift;
+    const unsigned char *byte;
     unsigned char packed;
     char   ch;
     text  *result_text;
 
     arg = PG_GETARG_DATUM(0);
-    dna = (Dna *) PG_DETOAST_DATUM(arg);
-
-    check_dna_consistency(dna);
-
     idx = PG_GETARG_INT32(1);
-    n   = dna->length;
+    n   = dna_fetch_length(arg);
 
     if (idx < 1 || (uint32) idx > n)
     {
@@ -279,13 +350,90 @@ dna_get(PG_FUNCTION_ARGS)
     // Convert to 0-based index
     i = (uint32) (idx - 1);
 
-    byte_index = i / 4;
-    shift      = (3 - (i % 4)) * 2;
-
-    packed = (unsigned char) ((dna->data[byte_index] >> shift) & 0x03);
+    // only the byte holding base i is fetched
+    shift  = (3 - (i % 4)) * 2;
+    byte   = (const unsigned char *) VARDATA_ANY(dna_fetch_packed(arg, i / 4, 1));
+    packed = (unsigned char) ((byte[0] >> shift) & 0x03);
     ch = decode_base(packed);
 
     result_text = cstring_to_text_with_len(&ch, 1);
 
     PG_RETURN_TEXT_P(result_text);
 }
+
+
+/*
+ * dna_substr(dna, start, len) to dna
+ * Same bounds rules as substr(text): 1-based start, the part of
+ * [start, start + len) inside the sequence is returned.
+ * Only the packed bytes of the region are fetched; when start is not on a
+ * byte boundary the bases are shifted up by 2 * (start % 4) bits.
+ */
+Datum
+dna_substr(PG_FUNCTION_ARGS)
+{
+    Datum   arg;
+    int32   start;
+    int32   len;
+    uint32  n;
+    int64   from;
+    int64   to;
+    uint32  count;
+    uint32  first_byte;
+    uint32  packed_bytes;
+    int     shift;
+    const unsigned char *src;
+    Size    size;
+    Dna    *result;
+
+    arg   = PG_GETARG_DATUM(0);
+    start = PG_GETARG_INT32(1);
+    len   = PG_GETARG_INT32(2);
+
+    if (len < 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_SUBSTRING_ERROR),
+                 errmsg("negative substring length not allowed")));
+
+    n    = dna_fetch_length(arg);
+    from = Max((int64) start - 1, 0);
+    to   = Min((int64) start - 1 + len, (int64) n);
+    count = (to > from) ? (uint32) (to - from) : 0;
+
+    packed_bytes = DNA_PACKED_BYTES(count);
+    size   = offsetof(Dna, data) + packed_bytes;
+    result = (Dna *) palloc0(size);
+    SET_VARSIZE(result, size);
+    result->length = count;
+
+    if (count == 0)
+        PG_RETURN_POINTER(result);
+
+    first_byte = (uint32) from / 4;
+    shift      = 2 * (int) (from % 4);
+    src = (const unsigned char *)
+        VARDATA_ANY(dna_fetch_packed(arg, first_byte,
+                                     (uint32) (to - 1) / 4 - first_byte + 1));
+
+    if (shift == 0)
+        memcpy(result->data, src, packed_bytes);
+    else
+    {
+        uint32 last = (uint32) (to - 1) / 4 - first_byte;   // last source byte
+
+        for (uint32 j = 0; j < packed_bytes; j++)
+        {
+            unsigned char b = (unsigned char) (src[j] << shift);
+
+            if (j + 1 <= last)
+                b |= src[j + 1] >> (8 - shift);
+            result->data[j] = b;
+        }
+    }
+
+    // unused bits of the last byte must be zero so equal sequences compare equal
+    if (count % 4 != 0)
+        result->data[packed_bytes - 1] &= (unsigned char) (0xFF << (8 - 2 * (count % 4)));
+
+    PG_RETURN_POINTER(result);
+}
@@ -18,4 +18,20 @@ typedef struct Dna
     unsigned char data[FLEXIBLE_ARRAY_MEMBER]; // packed bases 
 } Dna;
 
+/*
+ * 2-bit code (0..3) of base i in a packed buffer.
+ * Packing is big-endian inside each byte: base 0 lives in bits 7..6.
+ */
+static inline int
+dna_get_code(const unsigned char *data, uint32 i)
+{
+    return (data[i >> 2] >> ((3 - (i & 3)) * 2)) & 0x03;
+}
+
+extern void check_dna_consistency(const Dna *dna);
+
+// length and packed bytes of a possibly toasted dna, read by slices
+extern uint32 dna_fetch_length(Datum arg);
+extern struct varlena *dna_fetch_packed(Datum arg, uint32 first, uint32 count);
+
 #endif 
@@ -0,0 +1,308 @@
+#include "postgres.h"
+
+#include "dna.h"
+#include "dna_codec.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DNA_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Kernels encode whole blocks (4 bases per output byte) and leave the tail
+ * to the scalar code. They return the number of input characters they
+ * consumed; on an invalid character they stop before the offending block,
+ * and the scalar code then locates it exactly.
+ */
+typedef uint32 (*dna_encode_block_fn) (const char *in, uint32 n, unsigned char *out);
+typedef uint32 (*dna_decode_block_fn) (const unsigned char *in, uint32 n, char *out);
+
+static uint32 encode_blocks_none(const char *in, uint32 n, unsigned char *out);
+static uint32 decode_blocks_none(const unsigned char *in, uint32 n, char *out);
+
+static dna_encode_block_fn encode_blocks = encode_blocks_none;
+static dna_decode_block_fn decode_blocks = decode_blocks_none;
+
+// code + 1 for A/C/G/T in either case, 0 for anything else
+static unsigned char encode_table[256];
+
+// the 4 characters encoded by each packed byte
+static char decode_table[256][4];
+
+static bool codec_initialized = false;
+
+
+/* ---------- portable kernels ---------- */
+
+static uint32
+encode_blocks_none(const char *in, uint32 n, unsigned char *out)
+{
+    return 0;
+}
+
+// One table lookup per packed byte instead of per base
+static uint32
+decode_blocks_none(const unsigned char *in, uint32 n, char *out)
+{
+    uint32 nbytes = n / 4;
+
+    for (uint32 i = 0; i < nbytes; i++)
+        memcpy(out + 4 * i, decode_table[in[i]], 4);
+
+    return nbytes * 4;
+}
+
+
+#ifdef DNA_CODEC_X86
+
+/* ---------- SSE2: 16 bases per iteration ---------- */
+
+/*
+ * Classify 16 characters: returns the per-byte 2-bit codes and sets *ok
+ * when every byte is one of A/C/G/T (case folded with & 0xDF, which only
+ * maps the lowercase letters onto their uppercase form).
+ */
+static inline __m128i
+classify_sse2(__m128i v, bool *ok)
+{
+    __m128i u   = _mm_and_si128(v, _mm_set1_epi8((char) 0xDF));
+    __m128i isA = _mm_cmpeq_epi8(u, _mm_set1_epi8('A'));
+    __m128i isC = _mm_cmpeq_epi8(u, _mm_set1_epi8('C'));
+    __m128i isG = _mm_cmpeq_epi8(u, _mm_set1_epi8('G'));
+    __m128i isT = _mm_cmpeq_epi8(u, _mm_set1_epi8('T'));
+    __m128i any = _mm_or_si128(_mm_or_si128(isA, isC), _mm_or_si128(isG, isT));
+
+    *ok = (_mm_movemask_epi8(any) == 0xFFFF);
+
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(isC, _mm_set1_epi8(1)),
+                                     _mm_and_si128(isG, _mm_set1_epi8(2))),
+                        _mm_and_si128(isT, _mm_set1_epi8(3)));
+}
+
+/*
+ * Each 32-bit lane holds 4 codes c0..c3 in bytes 0..3 (little endian);
+ * fold them into (c0<<6 | c1<<4 | c2<<2 | c3) in the low byte of the lane.
+ */
+static inline __m128i
+pack_lanes_sse2(__m128i codes)
+{
+    __m128i b0 = _mm_and_si128(_mm_slli_epi32(codes, 6),  _mm_set1_epi32(0xC0));
+    __m128i b1 = _mm_and_si128(_mm_srli_epi32(codes, 4),  _mm_set1_epi32(0x30));
+    __m128i b2 = _mm_and_si128(_mm_srli_epi32(codes, 14), _mm_set1_epi32(0x0C));
+    __m128i b3 = _mm_and_si128(_mm_srli_epi32(codes, 24), _mm_set1_epi32(0x03));
+
+    return _mm_or_si128(_mm_or_si128(b0, b1), _mm_or_si128(b2, b3));
+}
+
+static uint32
+encode_blocks_sse2(const char *in, uint32 n, unsigned char *out)
+{
+    uint32 i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        bool    ok;
+        __m128i codes = classify_sse2(_mm_loadu_si128((const __m128i *) (in + i)), &ok);
+        __m128i lanes;
+        int32   packed;
+
+        if (!ok)
+            break;
+
+        lanes  = pack_lanes_sse2(codes);
+        lanes  = _mm_packs_epi32(lanes, lanes);
+        lanes  = _mm_packus_epi16(lanes, lanes);
+        packed = _mm_cvtsi128_si32(lanes);
+        memcpy(out + i / 4, &packed, 4);
+    }
+
+    return i;
+}
+
+
+/* ---------- AVX2: 32 bases per iteration ---------- */
+
+__attribute__((target("avx2")))
+static uint32
+encode_blocks_avx2(const char *in, uint32 n, unsigned char *out)
+{
+    const __m256i fold  = _mm256_set1_epi8((char) 0xDF);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1,
+                                            -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1,
+                                            -1, -1, -1, -1, -1, -1, -1, -1);
+    uint32 i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v   = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i u   = _mm256_and_si256(v, fold);
+        __m256i isA = _mm256_cmpeq_epi8(u, _mm256_set1_epi8('A'));
+        __m256i isC = _mm256_cmpeq_epi8(u, _mm256_set1_epi8('C'));
+        __m256i isG = _mm256_cmpeq_epi8(u, _mm256_set1_epi8('G'));
+        __m256i isT = _mm256_cmpeq_epi8(u, _mm256_set1_epi8('T'));
+        __m256i any = _mm256_or_si256(_mm256_or_si256(isA, isC),
+                                      _mm256_or_si256(isG, isT));
+        __m256i codes;
+        __m256i lanes;
+        uint32  lo;
+        uint32  hi;
+
+        if ((uint32) _mm256_movemask_epi8(any) != 0xFFFFFFFFU)
+            break;
+
+        codes = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(isC, _mm256_set1_epi8(1)),
+                                                _mm256_and_si256(isG, _mm256_set1_epi8(2))),
+                                _mm256_and_si256(isT, _mm256_set1_epi8(3)));
+
+        // same lane folding as the SSE2 kernel
+        lanes = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(codes, 6),  _mm256_set1_epi32(0xC0)),
+                            _mm256_and_si256(_mm256_srli_epi32(codes, 4),  _mm256_set1_epi32(0x30))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(codes, 14), _mm256_set1_epi32(0x0C)),
+                            _mm256_and_si256(_mm256_srli_epi32(codes, 24), _mm256_set1_epi32(0x03))));
+
+        // gather the low byte of each lane: bytes 0..3 of each 128-bit half
+        lanes = _mm256_shuffle_epi8(lanes, gather);
+        lo = (uint32) _mm256_extract_epi32(lanes, 0);
+        hi = (uint32) _mm256_extract_epi32(lanes, 4);
+        memcpy(out + i / 4, &lo, 4);
+        memcpy(out + i / 4 + 4, &hi, 4);
+    }
+
+    return i;
+}
+
+/*
+ * Unpack 8 packed bytes into 32 characters: replicate each byte 4 times,
+ * bring the 2 bits of each position down with 16-bit shifts, then map
+ * codes to letters with a byte shuffle.
+ */
+__attribute__((target("avx2")))
+static uint32
+decode_blocks_avx2(const unsigned char *in, uint32 n, char *out)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5,
+                                            6, 6, 6, 6, 7, 7, 7, 7);
+    const __m256i m0 = _mm256_set1_epi32(0x00000003);
+    const __m256i m1 = _mm256_set1_epi32(0x00000300);
+    const __m256i m2 = _mm256_set1_epi32(0x00030000);
+    const __m256i m3 = _mm256_set1_epi32(0x03000000);
+    const __m256i letters = _mm256_setr_epi8('A', 'C', 'G', 'T', 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0,
+                                             'A', 'C', 'G', 'T', 0, 0, 0, 0,
+                                             0, 0, 0, 0, 0, 0, 0, 0);
+    uint32 i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        int64   word;
+        __m256i rep;
+        __m256i codes;
+
+        memcpy(&word, in + i / 4, 8);
+        rep = _mm256_shuffle_epi8(_mm256_set1_epi64x(word), spread);
+
+        codes = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rep, 6), m0),
+                            _mm256_and_si256(_mm256_srli_epi16(rep, 4), m1)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rep, 2), m2),
+                            _mm256_and_si256(rep, m3)));
+
+        _mm256_storeu_si256((__m256i *) (out + i),
+                            _mm256_shuffle_epi8(letters, codes));
+    }
+
+    return i;
+}
+
+#endif                          /* DNA_CODEC_X86 */
+
+
+/* ---------- dispatch ---------- */
+
+void
+dna_codec_init(void)
+{
+    static const char bases[4] = { 'A', 'C', 'G', 'T' };
+
+    if (codec_initialized)
+        return;
+
+    memset(encode_table, 0, sizeof(encode_table));
+    for (int b = 0; b < 4; b++)
+    {
+        encode_table[(unsigned char) bases[b]] = (unsigned char) (b + 1);
+        encode_table[(unsigned char) (bases[b] | 0x20)] = (unsigned char) (b + 1);
+    }
+
+    for (int byte = 0; byte < 256; byte++)
+        for (int j = 0; j < 4; j++)
+            decode_table[byte][j] = bases[(byte >> ((3 - j) * 2)) & 0x03];
+
+#ifdef DNA_CODEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        encode_blocks = encode_blocks_avx2;
+        decode_blocks = decode_blocks_avx2;
+    }
+    else
+    {
+        // SSE2 is part of x86-64; no SSSE3 shuffle for decoding
+        encode_blocks = encode_blocks_sse2;
+        decode_blocks = decode_blocks_none;
+    }
+#endif
+
+    codec_initialized = true;
+}
+
+bool
+dna_encode(const char *in, uint32 n, unsigned char *out, uint32 *bad)
+{
+    uint32 i;
+
+    i = encode_blocks(in, n, out);
+
+    // scalar tail (and exact error position when a block was rejected)
+    for (; i < n; i += 4)
+    {
+        unsigned char byte = 0;
+
+        for (uint32 j = 0; j < 4; j++)
+        {
+            unsigned char code;
+
+            if (i + j >= n)
+                break;
+
+            code = encode_table[(unsigned char) in[i + j]];
+            if (code == 0)
+            {
+                *bad = i + j;
+                return false;
+            }
+            byte |= (unsigned char) ((code - 1) << ((3 - j) * 2));
+        }
+        out[i / 4] = byte;
+    }
+
+    return true;
+}
+
+void
+dna_decode(const unsigned char *in, uint32 n, char *out)
+{
+    uint32 i;
+
+    i = decode_blocks(in, n, out);
+    i += decode_blocks_none(in + i / 4, n - i, out + i);
+
+    for (; i < n; i++)
+        out[i] = decode_table[in[i / 4]][i % 4];
+}
@@ -0,0 +1,23 @@
+#ifndef PG_DNA_DNA_CODEC_H
+#define PG_DNA_DNA_CODEC_H
+
+#include "postgres.h"
+
+/*
+ * Bulk 2-bit encode/decode of A/C/G/T text, shared by dna_in / dna_out.
+ *
+ * dna_encode packs n characters (case-insensitive) into DNA_PACKED_BYTES(n)
+ * bytes, big-endian inside each byte. It returns false on the first
+ * invalid character and stores its index in *bad.
+ *
+ * dna_decode unpacks n bases into n characters (no terminating '\0').
+ *
+ * Both dispatch through function pointers picked once by dna_codec_init()
+ * from the CPU features (AVX2, SSE2, or a portable table-driven kernel).
+ */
+extern bool dna_encode(const char *in, uint32 n, unsigned char *out, uint32 *bad);
+extern void dna_decode(const unsigned char *in, uint32 n, char *out);
+
+extern void dna_codec_init(void);
+
+#endif
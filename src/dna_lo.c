@@ -0,0 +1,297 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "executor/executor.h"
+#include "libpq/libpq-fs.h"
+#include "storage/large_object.h"
+#include "utils/memutils.h"
+
+#include "dna.h"
+#include "dna_reader.h"
+#include "kmer.h"
+
+#include <string.h>
+
+/*
+ * Chunked storage for sequences beyond the dna varlena limits
+ * (DNA_MAX_LENGTH bases, 1 GB per value): a large object holding a
+ * DnaLoHeader and then the packed bases, in the same layout as Dna.data.
+ *
+ *   SELECT dna_lo_create();                     -- empty sequence
+ *   SELECT dna_lo_append(lo, seq) FROM ...;     -- load it piece by piece
+ *
+ * Everything that reads it goes through a DnaReader, one chunk at a time.
+ */
+
+PG_FUNCTION_INFO_V1(dna_lo_create);
+PG_FUNCTION_INFO_V1(dna_lo_append);
+PG_FUNCTION_INFO_V1(dna_lo_length);
+PG_FUNCTION_INFO_V1(dna_lo_substr);
+PG_FUNCTION_INFO_V1(dna_lo_kmers);
+
+
+static void
+write_exact(LargeObjectDesc *lo, int64 offset, const unsigned char *bytes, uint32 nbytes)
+{
+    if (inv_seek(lo, offset, SEEK_SET) != offset ||
+        inv_write(lo, (const char *) bytes, (int) nbytes) != (int) nbytes)
+        ereport(ERROR,
+                (errcode(ERRCODE_IO_ERROR),
+                 errmsg("could not write to dna large object")));
+}
+
+// dna_lo_create() to oid: a new, empty dna large object
+Datum
+dna_lo_create(PG_FUNCTION_ARGS)
+{
+    Oid              loid;
+    LargeObjectDesc *lo;
+    DnaLoHeader      header;
+
+    loid = inv_create(InvalidOid);
+    lo   = inv_open(loid, INV_WRITE, CurrentMemoryContext);
+
+    memset(&header, 0, sizeof(header));
+    header.magic   = DNA_LO_MAGIC;
+    header.version = DNA_LO_VERSION;
+    header.length  = 0;
+    write_exact(lo, 0, (const unsigned char *) &header, sizeof(header));
+
+    inv_close(lo);
+    PG_RETURN_OID(loid);
+}
+
+/*
+ * dna_lo_append(oid, dna) to bigint (the new length)
+ * When the stored length is not a multiple of 4, the last stored byte is
+ * only partly used: the appended bytes are shifted down by 2 * (length % 4)
+ * bits and merged into it. Padding bits stay zero on both sides.
+ */
+Datum
+dna_lo_append(PG_FUNCTION_ARGS)
+{
+    Oid              loid = PG_GETARG_OID(0);
+    DnaReader       *input;
+    LargeObjectDesc *lo;
+    DnaLoHeader      header;
+    uint64           old_length;
+    uint64           out_byte;
+    int              shift;
+    unsigned char    carry = 0;
+    unsigned char   *out;
+    uint64           first = 0;
+
+    input = dna_reader_open(PG_GETARG_DATUM(1));
+
+    lo = inv_open(loid, INV_READ | INV_WRITE, CurrentMemoryContext);
+    dna_lo_read_header(lo, loid, &header);
+
+    old_length = header.length;
+    out_byte   = old_length / 4;
+    shift      = 2 * (int) (old_length % 4);
+
+    if (shift != 0 &&
+        (inv_seek(lo, (int64) (sizeof(DnaLoHeader) + out_byte), SEEK_SET) < 0 ||
+         inv_read(lo, (char *) &carry, 1) != 1))
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("dna large object %u is corrupted: packed data too short", loid)));
+
+    out = (unsigned char *) palloc(DNA_READER_CHUNK);
+
+    for (;;)
+    {
+        uint32               nbytes;
+        const unsigned char *in = dna_reader_chunk(input, first, &nbytes);
+
+        if (in == NULL)
+            break;
+
+        if (shift == 0)
+            write_exact(lo, (int64) (sizeof(DnaLoHeader) + out_byte), in, nbytes);
+        else
+        {
+            for (uint32 j = 0; j < nbytes; j++)
+            {
+                out[j] = carry | (unsigned char) (in[j] >> shift);
+                carry  = (unsigned char) (in[j] << (8 - shift));
+            }
+            write_exact(lo, (int64) (sizeof(DnaLoHeader) + out_byte), out, nbytes);
+        }
+        out_byte += nbytes;
+        first    += nbytes;
+    }
+
+    // bases of the last input byte that did not fit in the last output byte
+    if (out_byte < (old_length + input->length + 3) / 4)
+        write_exact(lo, (int64) (sizeof(DnaLoHeader) + out_byte), &carry, 1);
+
+    header.length = old_length + input->length;
+    write_exact(lo, 0, (const unsigned char *) &header, sizeof(header));
+
+    inv_close(lo);
+    dna_reader_close(input);
+    pfree(out);
+
+    PG_RETURN_INT64((int64) header.length);
+}
+
+// dna_lo_length(oid) to bigint
+Datum
+dna_lo_length(PG_FUNCTION_ARGS)
+{
+    DnaReader *reader = dna_reader_open_lo(PG_GETARG_OID(0), CurrentMemoryContext);
+    uint64     length = reader->length;
+
+    dna_reader_close(reader);
+    PG_RETURN_INT64((int64) length);
+}
+
+/*
+ * dna_lo_substr(oid, start bigint, len integer) to dna
+ * Same bounds rules as dna_substr; the region must fit in a dna value.
+ */
+Datum
+dna_lo_substr(PG_FUNCTION_ARGS)
+{
+    DnaReader *reader;
+    int64      start = PG_GETARG_INT64(1);
+    int32      len   = PG_GETARG_INT32(2);
+    int64      from;
+    int64      to;
+    uint32     count;
+    Size       size;
+    Dna       *result;
+
+    if (len < 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_SUBSTRING_ERROR),
+                 errmsg("negative substring length not allowed")));
+
+    reader = dna_reader_open_lo(PG_GETARG_OID(0), CurrentMemoryContext);
+
+    from = Max(start - 1, 0);
+    to   = Min(start - 1 + len, (int64) reader->length);
+    count = (to > from) ? (uint32) (to - from) : 0;
+
+    if (count > DNA_MAX_LENGTH)
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("DNA sequence too long (%u bases, max is %u)",
+                        count, DNA_MAX_LENGTH)));
+
+    size   = offsetof(Dna, data) + DNA_PACKED_BYTES(count);
+    result = (Dna *) palloc0(size);
+    SET_VARSIZE(result, size);
+    result->length = count;
+
+    for (uint32 j = 0; j < count; j++)
+        result->data[j >> 2] |= (unsigned char)
+            (dna_reader_code(reader, (uint64) from + j) << ((3 - (j & 3)) * 2));
+
+    dna_reader_close(reader);
+    PG_RETURN_POINTER(result);
+}
+
+
+/*
+ * dna_lo_kmers(oid, k) -> SETOF (kmer, pos bigint)
+ * Value-per-call, so the rows stream out as the large object is read;
+ * the window is rolled as in generate_kmers. If the scan stops early
+ * (LIMIT, cursor), the shutdown callback closes the large object.
+ */
+typedef struct LoKmersState
+{
+    DnaReader *reader;
+    int32      k;
+    uint64     pos;        // index of the next base to shift into the window
+    uint64     window;
+    uint64     mask;
+} LoKmersState;
+
+static void
+lo_kmers_shutdown(Datum arg)
+{
+    LoKmersState *state = (LoKmersState *) DatumGetPointer(arg);
+
+    dna_reader_close(state->reader);
+}
+
+Datum
+dna_lo_kmers(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+    LoKmersState    *state;
+    ReturnSetInfo   *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        MemoryContext oldcontext;
+        TupleDesc     tupdesc;
+        int32         k = PG_GETARG_INT32(1);
+
+        // same limits and messages as generate_kmers
+        check_window_size(k);
+
+        funcctx    = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+            ereport(ERROR,
+                    (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                     errmsg("function returning record called in context "
+                            "that cannot accept type record")));
+        funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+        state = (LoKmersState *) palloc0(sizeof(LoKmersState));
+        state->reader = dna_reader_open_lo(PG_GETARG_OID(0), funcctx->multi_call_memory_ctx);
+        state->k      = k;
+        state->mask   = (UINT64CONST(1) << (2 * k)) - 1;
+
+        // prime the window with the first k-1 bases
+        if (state->reader->length >= (uint64) k)
+            for (; state->pos < (uint64) (k - 1); state->pos++)
+                state->window = (state->window << 2) |
+                    (uint64) dna_reader_code(state->reader, state->pos);
+        else
+            state->pos = state->reader->length;
+
+        RegisterExprContextCallback(rsinfo->econtext, lo_kmers_shutdown,
+                                    PointerGetDatum(state));
+        funcctx->user_fctx = state;
+
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    state   = (LoKmersState *) funcctx->user_fctx;
+
+    if (state->pos >= state->reader->length)
+    {
+        UnregisterExprContextCallback(rsinfo->econtext, lo_kmers_shutdown,
+                                      PointerGetDatum(state));
+        dna_reader_close(state->reader);
+        SRF_RETURN_DONE(funcctx);
+    }
+
+    {
+        Datum     values[2];
+        bool      nulls[2] = {false, false};
+        HeapTuple tuple;
+
+        state->window = ((state->window << 2) |
+                         (uint64) dna_reader_code(state->reader, state->pos)) &
+                        state->mask;
+        state->pos++;
+
+        values[0] = KmerGetDatum(kmer_from_window(state->window, state->k));
+        values[1] = Int64GetDatum((int64) (state->pos - (uint64) state->k + 1));
+        tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+}
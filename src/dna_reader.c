@@ -0,0 +1,168 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "access/detoast.h"
+#include "libpq/libpq-fs.h"
+#include "storage/large_object.h"
+#include "utils/memutils.h"
+
+#include "dna_reader.h"
+
+#include <string.h>
+
+// packed bytes [first, first + count) of an out-of-line dna value
+static void
+read_slice(Datum datum, uint64 first, uint32 count, unsigned char *dst)
+{
+    struct varlena *slice = dna_fetch_packed(datum, (uint32) first, count);
+
+    memcpy(dst, VARDATA_ANY(slice), count);
+    pfree(slice);
+}
+
+// packed bytes [first, first + count) of a dna large object
+static void
+read_lo(DnaReader *reader, uint64 first, uint32 count, unsigned char *dst)
+{
+    int64 offset = (int64) (sizeof(DnaLoHeader) + first);
+
+    if (inv_seek(reader->lo, offset, SEEK_SET) != offset ||
+        inv_read(reader->lo, (char *) dst, (int) count) != (int) count)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("dna large object is corrupted: packed data too short")));
+}
+
+static void
+read_bytes(DnaReader *reader, uint64 first, uint32 count, unsigned char *dst)
+{
+    if (reader->lo)
+        read_lo(reader, first, count, dst);
+    else
+        read_slice(reader->datum, first, count, dst);
+}
+
+/*
+ * Only values stored out of line without compression are read by slices:
+ * a slice of a compressed value decompresses everything before it, which
+ * would make a scan quadratic.
+ */
+DnaReader *
+dna_reader_open(Datum datum)
+{
+    struct varlena *raw = (struct varlena *) DatumGetPointer(datum);
+    DnaReader      *reader = (DnaReader *) palloc0(sizeof(DnaReader));
+    Dna            *dna;
+
+    reader->mcxt = CurrentMemoryContext;
+
+    if (VARATT_IS_EXTERNAL_ONDISK(raw))
+    {
+        struct varatt_external toast_pointer;
+
+        VARATT_EXTERNAL_GET_POINTER(toast_pointer, raw);
+        if (!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+        {
+            reader->datum  = datum;
+            reader->length = dna_fetch_length(datum);
+            return reader;
+        }
+    }
+
+    dna = (Dna *) PG_DETOAST_DATUM(datum);
+    check_dna_consistency(dna);
+    reader->data   = dna->data;
+    reader->length = dna->length;
+    return reader;
+}
+
+void
+dna_lo_read_header(LargeObjectDesc *lo, Oid loid, DnaLoHeader *header)
+{
+    if (inv_seek(lo, 0, SEEK_SET) != 0 ||
+        inv_read(lo, (char *) header, sizeof(DnaLoHeader)) != (int) sizeof(DnaLoHeader) ||
+        header->magic != DNA_LO_MAGIC)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("large object %u is not a dna large object", loid)));
+
+    if (header->version != DNA_LO_VERSION)
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("dna large object %u has unsupported version %u",
+                        loid, header->version)));
+}
+
+// mcxt must outlive the reader (the descriptor is allocated there)
+DnaReader *
+dna_reader_open_lo(Oid loid, MemoryContext mcxt)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(mcxt);
+    DnaReader    *reader = (DnaReader *) palloc0(sizeof(DnaReader));
+    DnaLoHeader   header;
+
+    reader->mcxt = mcxt;
+    reader->lo   = inv_open(loid, INV_READ, mcxt);
+    dna_lo_read_header(reader->lo, loid, &header);
+    reader->length = header.length;
+
+    MemoryContextSwitchTo(oldcxt);
+    return reader;
+}
+
+void
+dna_reader_close(DnaReader *reader)
+{
+    if (reader->lo)
+    {
+        inv_close(reader->lo);
+        reader->lo = NULL;
+    }
+}
+
+/*
+ * Up to DNA_READER_CHUNK packed bytes starting at first_byte (NULL past the
+ * end). The last byte may hold padding bases beyond the length.
+ * The result stays valid until the next call.
+ */
+const unsigned char *
+dna_reader_chunk(DnaReader *reader, uint64 first_byte, uint32 *nbytes)
+{
+    uint64 total = (reader->length + 3) / 4;
+
+    if (first_byte >= total)
+    {
+        *nbytes = 0;
+        return NULL;
+    }
+
+    // callers size their buffers from DNA_READER_CHUNK, in memory too
+    *nbytes = (uint32) Min(total - first_byte, (uint64) DNA_READER_CHUNK);
+
+    if (reader->data)
+        return reader->data + first_byte;
+
+    if (reader->chunk == NULL)
+        reader->chunk = (unsigned char *) MemoryContextAlloc(reader->mcxt, DNA_READER_CHUNK);
+    read_bytes(reader, first_byte, *nbytes, reader->chunk);
+    return reader->chunk;
+}
+
+// refill the random-access window so that it starts at byte
+void
+dna_reader_fill_peek(DnaReader *reader, uint64 byte)
+{
+    uint64 total = (reader->length + 3) / 4;
+
+    if (byte >= total)
+        elog(ERROR, "dna reader: byte " UINT64_FORMAT " out of range", byte);
+
+    if (reader->peek == NULL)
+        reader->peek = (unsigned char *) MemoryContextAlloc(reader->mcxt, DNA_READER_PEEK);
+
+    reader->peek_first = byte;
+    reader->peek_len   = (uint32) Min(total - byte, (uint64) DNA_READER_PEEK);
+    read_bytes(reader, byte, reader->peek_len, reader->peek);
+}
@@ -0,0 +1,75 @@
+#ifndef PG_DNA_DNA_READER_H
+#define PG_DNA_DNA_READER_H
+
+#include "postgres.h"
+#include "storage/large_object.h"
+
+#include "dna.h"
+
+/*
+ * Streaming reader over the packed bases of a sequence, in bounded memory.
+ *
+ * Sources:
+ *  - a dna value: read in place when it is in memory or compressed, or
+ *    by toast slices when it is stored out of line uncompressed (the
+ *    default STORAGE EXTERNAL), so a 100 Mbp row is never copied whole;
+ *  - a dna large object (see dna_lo.c): a 16-byte header followed by the
+ *    packed bases, with a 64-bit length and no 1 GB varlena limit.
+ *
+ * dna_reader_chunk() hands out consecutive runs of packed bytes for scans;
+ * dna_reader_code() is random access through a separate small window, so
+ * it can be used while a chunk is being scanned.
+ */
+
+// header at offset 0 of a dna large object, the packed bases follow
+#define DNA_LO_MAGIC    0x32414E44      // "DNA2"
+#define DNA_LO_VERSION  1
+
+typedef struct DnaLoHeader
+{
+    uint32  magic;
+    uint32  version;
+    uint64  length;     // bases
+} DnaLoHeader;
+
+#define DNA_READER_CHUNK  (256 * 1024)     // packed bytes per scan read (1M bases)
+#define DNA_READER_PEEK   (16 * 1024)      // packed bytes per random-access read
+
+typedef struct DnaReader
+{
+    uint64           length;        // bases
+    MemoryContext    mcxt;          // buffers are allocated here
+    const unsigned char *data;      // whole packed data, when in memory
+    Datum            datum;         // out-of-line dna, read by slices
+    LargeObjectDesc *lo;            // dna large object
+    unsigned char   *chunk;         // scan buffer
+    unsigned char   *peek;          // random-access window ...
+    uint64           peek_first;    // ... starting at this byte
+    uint32           peek_len;
+} DnaReader;
+
+extern DnaReader *dna_reader_open(Datum dna);
+extern DnaReader *dna_reader_open_lo(Oid loid, MemoryContext mcxt);
+extern void dna_reader_close(DnaReader *reader);
+extern void dna_lo_read_header(LargeObjectDesc *lo, Oid loid, DnaLoHeader *header);
+
+extern const unsigned char *dna_reader_chunk(DnaReader *reader, uint64 first_byte,
+                                             uint32 *nbytes);
+extern void dna_reader_fill_peek(DnaReader *reader, uint64 byte);
+
+// 2-bit code of base i (i < length)
+static inline int
+dna_reader_code(DnaReader *reader, uint64 i)
+{
+    uint64 byte = i >> 2;
+
+    if (reader->data)
+        return dna_get_code(reader->data, (uint32) i);
+
+    if (byte - reader->peek_first >= reader->peek_len)
+        dna_reader_fill_peek(reader, byte);
+
+    return (reader->peek[byte - reader->peek_first] >> ((3 - (i & 3)) * 2)) & 0x03;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+
+#include "dna_search.h"
+
+/*
+ * Shift-or: bit j of the state is 0 when the last j+1 bases match the
+ * first j+1 pattern positions, and masks[c] has bit j set when position j
+ * rejects base c, so each base costs state = (state << 1) | masks[c].
+ *
+ * The steps are linear, so the 4 bases of a packed byte fold into one:
+ *
+ *   state = (state << 4) | table[byte]
+ *   table[byte] = masks[c0] << 3 | masks[c1] << 2 | masks[c2] << 1 | masks[c3]
+ *
+ * and the match bit after base i of the byte is left at bit
+ * filter_length - 1 + (3 - i) of the new state. With filter_length <= 61
+ * those 4 bits still fit in the word.
+ */
+
+static DnaPattern *
+pattern_alloc(uint32 length)
+{
+    DnaPattern *pattern;
+
+    pattern = (DnaPattern *) palloc0(offsetof(DnaPattern, accept) + Max(length, 1));
+    pattern->length = length;
+    pattern->filter_length = (int) Min(length, (uint32) DNA_SEARCH_FILTER_LENGTH);
+    return pattern;
+}
+
+// fill table[] from the accept sets of the filter positions
+static void
+pattern_compile(DnaPattern *pattern)
+{
+    uint64 masks[4] = {0, 0, 0, 0};
+
+    for (int j = 0; j < pattern->filter_length; j++)
+        for (int code = 0; code < 4; code++)
+            if (!(pattern->accept[j] & (1 << code)))
+                masks[code] |= UINT64CONST(1) << j;
+
+    for (int byte = 0; byte < 256; byte++)
+        pattern->table[byte] = (masks[(byte >> 6) & 3] << 3) |
+                               (masks[(byte >> 4) & 3] << 2) |
+                               (masks[(byte >> 2) & 3] << 1) |
+                                masks[byte & 3];
+}
+
+DnaPattern *
+dna_pattern_from_dna(const Dna *dna)
+{
+    DnaPattern *pattern = pattern_alloc(dna->length);
+
+    for (uint32 j = 0; j < dna->length; j++)
+        pattern->accept[j] = (uint8) (1 << dna_get_code(dna->data, j));
+
+    pattern_compile(pattern);
+    return pattern;
+}
+
+DnaPattern *
+dna_pattern_from_kmer(Kmer kmer)
+{
+    int         length = kmer_length_internal(kmer);
+    DnaPattern *pattern = pattern_alloc(length);
+
+    for (int j = 0; j < length; j++)
+        pattern->accept[j] = (uint8) (1 << kmer_get_code(kmer, j));
+
+    pattern_compile(pattern);
+    return pattern;
+}
+
+DnaPattern *
+dna_pattern_from_qkmer(const QKmer *qkmer)
+{
+    int         length = qkmer_length_internal(qkmer);
+    DnaPattern *pattern = pattern_alloc(length);
+
+    // the stored base sets use the same bit per code as accept[]
+    for (int j = 0; j < length; j++)
+        pattern->accept[j] = (uint8) qkmer_get_set(qkmer, j);
+
+    pattern_compile(pattern);
+    return pattern;
+}
+
+// positions beyond the shift-or filter, checked at a candidate start
+static inline bool
+verify_tail(const DnaPattern *pattern, DnaReader *text, uint64 start)
+{
+    if (start + pattern->length > text->length)
+        return false;
+
+    for (uint32 j = pattern->filter_length; j < pattern->length; j++)
+        if (!(pattern->accept[j] & (1 << dna_reader_code(text, start + j))))
+            return false;
+    return true;
+}
+
+// one run of packed bytes starting at byte first; false once the search stops
+static bool
+scan_bytes(const DnaPattern *pattern, DnaReader *text, uint64 *state,
+           const unsigned char *bytes, uint32 nbytes, uint64 first,
+           DnaMatchCallback callback, void *arg)
+{
+    int     f = pattern->filter_length;
+    uint64  s = *state;
+
+    for (uint32 b = 0; b < nbytes; b++)
+    {
+        uint32 hits;
+
+        s = (s << 4) | pattern->table[bytes[b]];
+
+        hits = (uint32) (~s >> (f - 1)) & 0xF;
+        if (likely(hits == 0))
+            continue;
+
+        for (int i = 0; i < 4; i++)
+        {
+            uint64 end = 4 * (first + b) + i;
+
+            if (!(hits & (8 >> i)))
+                continue;
+
+            // the padding of the last byte reads as A
+            if (end >= text->length)
+                return false;
+
+            if (pattern->length > (uint32) f &&
+                !verify_tail(pattern, text, end + 1 - f))
+                continue;
+
+            if (!callback(end + 1 - f, arg))
+                return false;
+        }
+    }
+
+    *state = s;
+    return true;
+}
+
+/*
+ * Report the matches in order. The text is scanned chunk by chunk; the
+ * shift-or state carries over between chunks.
+ */
+void
+dna_search(const DnaPattern *pattern, DnaReader *text,
+           DnaMatchCallback callback, void *arg)
+{
+    uint64  state = ~UINT64CONST(0);
+    uint64  first = 0;
+
+    // the empty pattern matches at every position
+    if (pattern->length == 0)
+    {
+        for (uint64 start = 0; start <= text->length; start++)
+            if (!callback(start, arg))
+                return;
+        return;
+    }
+
+    if (pattern->length > text->length)
+        return;
+
+    for (;;)
+    {
+        uint32               nbytes;
+        const unsigned char *bytes = dna_reader_chunk(text, first, &nbytes);
+
+        if (bytes == NULL ||
+            !scan_bytes(pattern, text, &state, bytes, nbytes, first, callback, arg))
+            return;
+        first += nbytes;
+    }
+}
+
+static bool
+stop_at_first(uint64 start, void *arg)
+{
+    *(int64 *) arg = (int64) start;
+    return false;
+}
+
+// 0-based start of the first match, or -1
+int64
+dna_search_first(const DnaPattern *pattern, DnaReader *text)
+{
+    int64 first = -1;
+
+    dna_search(pattern, text, stop_at_first, &first);
+    return first;
+}
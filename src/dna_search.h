@@ -0,0 +1,41 @@
+#ifndef PG_DNA_DNA_SEARCH_H
+#define PG_DNA_DNA_SEARCH_H
+
+#include "postgres.h"
+
+#include "dna.h"
+#include "dna_reader.h"
+#include "kmer.h"
+#include "qkmer.h"
+
+/*
+ * Pattern search on 2-bit packed dna (shift-or, one packed byte per step).
+ *
+ * A pattern is compiled once from a dna, kmer or qkmer value; each pattern
+ * position accepts a set of bases (one base, or an IUPAC class). The first
+ * DNA_SEARCH_FILTER_LENGTH positions drive the shift-or state; the rest of
+ * a longer pattern is verified base by base at each candidate.
+ * The text is read through a DnaReader, so it is scanned chunk by chunk.
+ */
+#define DNA_SEARCH_FILTER_LENGTH 61
+
+typedef struct DnaPattern
+{
+    uint32  length;             // number of pattern positions
+    int     filter_length;      // positions covered by the shift-or state
+    uint64  table[256];         // shift-or masks of the 4 bases of a packed byte
+    uint8   accept[FLEXIBLE_ARRAY_MEMBER];  // per position: set of accepted codes
+} DnaPattern;
+
+// called for each match (0-based start); return false to stop the search
+typedef bool (*DnaMatchCallback) (uint64 start, void *arg);
+
+extern DnaPattern *dna_pattern_from_dna(const Dna *dna);
+extern DnaPattern *dna_pattern_from_kmer(Kmer kmer);
+extern DnaPattern *dna_pattern_from_qkmer(const QKmer *qkmer);
+
+extern void dna_search(const DnaPattern *pattern, DnaReader *text,
+                       DnaMatchCallback callback, void *arg);
+extern int64 dna_search_first(const DnaPattern *pattern, DnaReader *text);
+
+#endif
@@ -1,34 +1,58 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "funcapi.h"
+#include "nodes/execnodes.h"
 #include "utils/memutils.h"
+#include "utils/tuplestore.h"
 
+#include "dna.h"
+#include "dna_reader.h"
 #include "kmer.h"
 
 #include <string.h>
 
 PG_FUNCTION_INFO_V1(generate_kmers);
+PG_FUNCTION_INFO_V1(generate_kmers_positions);
 
-extern Datum dna_out(PG_FUNCTION_ARGS);
-extern Datum kmer_in(PG_FUNCTION_ARGS);
+// Validate the window size passed to the kmer generators
+void
+check_window_size(int32 k)
+{
+    if (k <= 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("k must be positive")));
+
+    if (k > KMER_MAX_LENGTH)
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("k-mer length %d exceeds maximum %d",
+                        k, KMER_MAX_LENGTH)));
+}
 
 //State carried across calls for the set-returning function
 
 typedef struct GenerateKmersState
 {
-    char   *dna_str;   // plain C string representation of the DNA sequence 
-    uint32  dna_len;   // length in characters (A/C/G/T) 
-    int32   k;         // window size 
-    uint32  pos;       // current start index (0-based) 
-    uint32  max_pos;   // number of windows = dna_len - k + 1 
+    DnaReader *reader; // streams the packed bases, see dna_reader.h
+    uint32  dna_len;   // length in bases
+    int32   k;         // window size
+    uint32  pos;       // index of the next base to shift into the window
+    uint64  window;    // last bases read, right-aligned, 2 bits each
+    uint64  mask;      // keeps the low 2k bits of the window
+    bool    canonical; // emit min(kmer, reverse complement)
+    uint64  rc_window; // reverse complement of the window, when canonical
 } GenerateKmersState;
 
 /*
- *  - call dna_out(dna) to get a C string like "ACGTAC..."
- *  - slide a window of length k over that string
- *  - for each window, build a kmer by calling kmer_in()
- *
- *   This way we never depend on the internal representation of dna.
+ *  - read 2-bit codes from the packed bases through a DnaReader, so an
+ *    out-of-line value is read chunk by chunk instead of detoasted whole
+ *  - keep the current window right-aligned in a uint64 and roll it
+ *    forward by one base per output row
+ *  - each kmer is the window moved to the top of the word plus the
+ *    terminator bit, so no text round-trip and O(1) work per kmer
+ *  - with canonical, the reverse complement is rolled alongside (as in
+ *    generate_kmers_positions) and the smaller of the two is emitted
  */
 Datum
 generate_kmers(PG_FUNCTION_ARGS)
@@ -39,46 +63,42 @@ generate_kmers(PG_FUNCTION_ARGS)
     if (SRF_IS_FIRSTCALL())
     {
         MemoryContext oldcontext;
-        char         *dna_str;
-        char         *dna_copy;
-        uint32        dna_len;
+        DnaReader    *reader;
         int32         k;
 
         k = PG_GETARG_INT32(1);
-        if (k <= 0)
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("k must be positive")));
-
-        if (k > KMER_MAX_LENGTH)
-            ereport(ERROR,
-                    (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
-                     errmsg("k-mer length %d exceeds maximum %d",
-                            k, KMER_MAX_LENGTH)));
+        check_window_size(k);
 
         funcctx = SRF_FIRSTCALL_INIT();
 
         // Switch to multi-call context so our state survives across calls
         oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
-        // Convert dna value to cstring using dna_out(dna)
-        dna_str = DatumGetCString(DirectFunctionCall1(dna_out,
-                                                      PG_GETARG_DATUM(0)));
-
-        // Copy it into this memory context
-        dna_copy = pstrdup(dna_str);
-        dna_len  = (uint32) strlen(dna_copy);
+        reader = dna_reader_open(PG_GETARG_DATUM(0));
 
         state = (GenerateKmersState *) palloc(sizeof(GenerateKmersState));
-        state->dna_str = dna_copy;
-        state->dna_len = dna_len;
+        state->reader  = reader;
+        state->dna_len = (uint32) reader->length;
         state->k       = k;
         state->pos     = 0;
-
-        if (dna_len >= (uint32) k)
-            state->max_pos = dna_len - (uint32) k + 1;
+        state->window  = 0;
+        state->mask    = (UINT64CONST(1) << (2 * k)) - 1;
+        state->canonical = PG_GETARG_BOOL(2);
+        state->rc_window = 0;
+
+        // Prime the window with the first k-1 bases
+        if (state->dna_len >= (uint32) k)
+        {
+            for (; state->pos < (uint32) (k - 1); state->pos++)
+            {
+                uint64 code = (uint64) dna_reader_code(reader, state->pos);
+
+                state->window    = (state->window << 2) | code;
+                state->rc_window = (state->rc_window >> 2) | ((3 - code) << (2 * (k - 1)));
+            }
+        }
         else
-            state->max_pos = 0;      // no windows
+            state->pos = state->dna_len;      // no windows
 
         funcctx->user_fctx = state;
 
@@ -89,28 +109,95 @@ generate_kmers(PG_FUNCTION_ARGS)
     funcctx = SRF_PERCALL_SETUP();
     state   = (GenerateKmersState *) funcctx->user_fctx;
 
-
-    if (state->pos >= state->max_pos)
+    if (state->pos >= state->dna_len)
         SRF_RETURN_DONE(funcctx);
 
-    // Build k-mer substring as cstring
+    // Shift the next base in and emit the window as a kmer word
     {
-        uint32 start = state->pos;
-        uint32 end   = start + (uint32) state->k;   // exclusive
-        char  *buf   = (char *) palloc(state->k + 1);
-        uint32 i;
-        Datum  kmer_datum;
+        Kmer   kmer;
+        uint64 code = (uint64) dna_reader_code(state->reader, state->pos);
 
-        for (i = start; i < end; i++)
-            buf[i - start] = state->dna_str[i];
+        state->window = ((state->window << 2) | code) & state->mask;
+        state->pos++;
 
-        buf[state->k] = '\0';
+        kmer = kmer_from_window(state->window, state->k);
 
-        // Turn substring into a kmer value using the existing kmer_in()
-        kmer_datum = DirectFunctionCall1(kmer_in, CStringGetDatum(buf));
+        if (state->canonical)
+        {
+            Kmer rc;
 
-        state->pos++;
+            state->rc_window = (state->rc_window >> 2) |
+                               ((3 - code) << (2 * (state->k - 1)));
+            rc = kmer_from_window(state->rc_window, state->k);
+            if (rc < kmer)
+                kmer = rc;
+        }
+
+        SRF_RETURN_NEXT(funcctx, KmerGetDatum(kmer));
+    }
+}
 
-        SRF_RETURN_NEXT(funcctx, kmer_datum);
+
+/*
+ * generate_kmers_positions(dna, k, both_strands) -> (kmer, pos, strand)
+ *
+ * Materialize-mode variant: the whole result is written to the tuplestore
+ * in one loop instead of one executor round-trip per kmer.
+ *  - pos is the 1-based start of the window on the forward strand
+ *  - strand is '+' for the window itself; with both_strands, the reverse
+ *    complement of each window is also emitted with strand '-'
+ * The reverse complement is rolled alongside the forward window: the
+ * complement of each new base (3 - code) enters at the top of the window.
+ */
+Datum
+generate_kmers_positions(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    DnaReader *reader;
+    int32   k;
+    bool    both_strands;
+    uint32  n;
+    uint64  window = 0;
+    uint64  rc_window = 0;
+    uint64  mask;
+    int     rc_shift;
+    Datum   values[3];
+    bool    nulls[3] = {false, false, false};
+
+    k = PG_GETARG_INT32(1);
+    check_window_size(k);
+    both_strands = PG_GETARG_BOOL(2);
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    reader = dna_reader_open(PG_GETARG_DATUM(0));
+
+    n        = (uint32) reader->length;
+    mask     = (UINT64CONST(1) << (2 * k)) - 1;
+    rc_shift = 2 * (k - 1);
+
+    for (uint32 i = 0; i < n; i++)
+    {
+        uint64 code = (uint64) dna_reader_code(reader, i);
+
+        window    = ((window << 2) | code) & mask;
+        rc_window = (rc_window >> 2) | ((3 - code) << rc_shift);
+
+        if (i + 1 < (uint32) k)
+            continue;
+
+        values[0] = KmerGetDatum(kmer_from_window(window, k));
+        values[1] = Int32GetDatum((int32) (i + 2 - (uint32) k));
+        values[2] = CharGetDatum('+');
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+        if (both_strands)
+        {
+            values[0] = KmerGetDatum(kmer_from_window(rc_window, k));
+            values[2] = CharGetDatum('-');
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+        }
     }
+
+    return (Datum) 0;
 }
@@ -0,0 +1,410 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "access/gin.h"
+#include "access/reloptions.h"
+#include "utils/memutils.h"
+
+#include "dna.h"
+#include "kmer.h"
+#include "qkmer.h"
+
+/*
+ * GIN opclass on dna for `dna @> kmer` and `dna @> qkmer`.
+ *
+ * The keys of a sequence are kmers of length k (opclass option, default
+ * DNA_GIN_DEFAULT_K):
+ *
+ *  - by default one key per position: the k bases starting there, or the
+ *    rest of the sequence for the last k-1 positions. Every substring of
+ *    the sequence is then a prefix of some key, so a probe shorter than k
+ *    is looked up with a GIN partial match on its bases;
+ *  - with minimizer_window = w > 1, only the minimizer of each run of w
+ *    consecutive k-mers is kept (smallest under a hash order). Any probe
+ *    of at least k + w - 1 bases contains a whole window, and its
+ *    minimizers are keys of every sequence containing it. Shorter probes
+ *    fall back to a full index scan.
+ *
+ * The keys are necessary, not sufficient, so every match is rechecked.
+ */
+#define DNA_GIN_DEFAULT_K 12
+#define DNA_GIN_MAX_WINDOW 32
+
+#define DNA_GIN_CONTAINS_KMER_STRATEGY  7
+#define DNA_GIN_CONTAINS_QKMER_STRATEGY 8
+
+typedef struct DnaGinOptions
+{
+    int32 vl_len_;               // varlena header (do not touch directly!)
+    int   k;                     // length of the index keys
+    int   minimizer_window;      // w, 1 = no sampling
+} DnaGinOptions;
+
+PG_FUNCTION_INFO_V1(dna_gin_options);
+PG_FUNCTION_INFO_V1(dna_gin_extract_value);
+PG_FUNCTION_INFO_V1(dna_gin_extract_query);
+PG_FUNCTION_INFO_V1(dna_gin_consistent);
+PG_FUNCTION_INFO_V1(dna_gin_triconsistent);
+PG_FUNCTION_INFO_V1(dna_gin_compare_partial);
+
+
+Datum
+dna_gin_options(PG_FUNCTION_ARGS)
+{
+    local_relopts *relopts = (local_relopts *) PG_GETARG_POINTER(0);
+
+    init_local_reloptions(relopts, sizeof(DnaGinOptions));
+    add_local_int_reloption(relopts, "k",
+                            "length of the kmers used as index keys",
+                            DNA_GIN_DEFAULT_K, 1, KMER_MAX_LENGTH,
+                            offsetof(DnaGinOptions, k));
+    add_local_int_reloption(relopts, "minimizer_window",
+                            "keep one kmer (the minimizer) per window of this many kmers",
+                            1, 1, DNA_GIN_MAX_WINDOW,
+                            offsetof(DnaGinOptions, minimizer_window));
+
+    PG_RETURN_VOID();
+}
+
+static void
+get_gin_options(FunctionCallInfo fcinfo, int *k, int *w)
+{
+    *k = DNA_GIN_DEFAULT_K;
+    *w = 1;
+
+    if (PG_HAS_OPCLASS_OPTIONS())
+    {
+        DnaGinOptions *options = (DnaGinOptions *) PG_GET_OPCLASS_OPTIONS();
+
+        *k = options->k;
+        *w = options->minimizer_window;
+    }
+}
+
+
+/*
+ * Key collection.
+ * A "run" is a stretch of known bases given as 2-bit codes.
+ *
+ * A long sequence has one key per base but far fewer distinct keys (at
+ * most about 4^k), so a full list is sorted and deduplicated in place and
+ * only grows when that does not free half of it. GIN copies the keys into
+ * entries twice their size to sort them, hence DNA_GIN_MAX_KEYS.
+ */
+#define DNA_GIN_MAX_KEYS ((int32) (MaxAllocSize / (2 * sizeof(Datum))))
+
+typedef struct KeyList
+{
+    Datum *keys;
+    int32  n;
+    int32  max;
+} KeyList;
+
+static int
+key_cmp(const void *a, const void *b)
+{
+    Kmer ka = DatumGetKmer(*(const Datum *) a);
+    Kmer kb = DatumGetKmer(*(const Datum *) b);
+
+    return (ka > kb) - (ka < kb);
+}
+
+static void
+keylist_compact(KeyList *list)
+{
+    int32 n = 0;
+
+    qsort(list->keys, list->n, sizeof(Datum), key_cmp);
+    for (int32 i = 0; i < list->n; i++)
+        if (n == 0 || list->keys[n - 1] != list->keys[i])
+            list->keys[n++] = list->keys[i];
+    list->n = n;
+}
+
+static void
+keylist_add(KeyList *list, Kmer key)
+{
+    // sampled runs often pick the same minimizer for consecutive windows
+    if (list->n > 0 && DatumGetKmer(list->keys[list->n - 1]) == key)
+        return;
+
+    if (list->n == list->max)
+    {
+        keylist_compact(list);
+        if (list->n > list->max / 2)
+        {
+            if (list->max > DNA_GIN_MAX_KEYS / 2)
+                ereport(ERROR,
+                        (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                         errmsg("dna value has too many distinct index keys"),
+                         errhint("Use a smaller k or a minimizer_window.")));
+            list->max *= 2;
+            list->keys = (Datum *) repalloc(list->keys, sizeof(Datum) * list->max);
+        }
+    }
+    list->keys[list->n++] = KmerGetDatum(key);
+}
+
+// hash order used to pick minimizers; ties broken on the kmer itself
+static inline bool
+minimizer_before(Kmer a, Kmer b)
+{
+    uint64 ha = kmer_mix64(a);
+    uint64 hb = kmer_mix64(b);
+
+    return ha < hb || (ha == hb && a < b);
+}
+
+/*
+ * Add the keys of a run of n codes. code(arg, i) returns the i-th code.
+ * With sampling, only the minimizers of the windows of w k-mers are kept;
+ * without, the k-mers and the trailing suffixes are (see the file header).
+ */
+static void
+add_run_keys(KeyList *list, int (*code) (const void *, uint32), const void *arg,
+             uint32 n, int k, int w, bool with_suffixes)
+{
+    int     m = (int) Min((uint32) k, n);
+    uint64  mask;
+    uint64  window = 0;
+    Kmer   *ring = NULL;        // last w k-mers, for the minimizer windows
+    uint32  nkmers;
+
+    if (n == 0)
+        return;
+
+    mask   = (UINT64CONST(1) << (2 * m)) - 1;
+    nkmers = n - m + 1;
+    if (w > 1)
+    {
+        if (m < k || nkmers < (uint32) w)
+            return;                 // no complete window
+        ring = (Kmer *) palloc(sizeof(Kmer) * w);
+    }
+
+    for (uint32 i = 0; i < n; i++)
+    {
+        Kmer   kmer;
+        uint32 start;
+
+        window = ((window << 2) | (uint64) code(arg, i)) & mask;
+        if (i + 1 < (uint32) m)
+            continue;
+
+        kmer  = kmer_from_window(window, m);
+        start = i + 1 - m;
+
+        if (w <= 1)
+            keylist_add(list, kmer);
+        else
+        {
+            ring[start % w] = kmer;
+            if (start + 1 >= (uint32) w)
+            {
+                Kmer best = ring[0];
+
+                for (int j = 1; j < w; j++)
+                    if (minimizer_before(ring[j], best))
+                        best = ring[j];
+                keylist_add(list, best);
+            }
+        }
+    }
+
+    // the last m-1 positions: suffixes of the last window
+    if (with_suffixes)
+    {
+        Kmer last = kmer_from_window(window, m);
+
+        for (int j = 1; j < m; j++)
+            keylist_add(list, ((last & (last - 1)) << (2 * j)) | KMER_TERMINATOR(m - j));
+    }
+
+    if (ring)
+        pfree(ring);
+}
+
+static int
+dna_code_at(const void *arg, uint32 i)
+{
+    return dna_get_code(((const Dna *) arg)->data, i);
+}
+
+static int
+kmer_code_at(const void *arg, uint32 i)
+{
+    return kmer_get_code(*(const Kmer *) arg, (int) i);
+}
+
+// a stretch of a qkmer pattern
+typedef struct QKmerRun
+{
+    const QKmer *pattern;
+    int          start;
+} QKmerRun;
+
+static int
+qkmer_code_at(const void *arg, uint32 i)
+{
+    const QKmerRun *run = (const QKmerRun *) arg;
+
+    return qkmer_get_code(run->pattern, run->start + (int) i);    // -1 if ambiguous
+}
+
+
+Datum
+dna_gin_extract_value(PG_FUNCTION_ARGS)
+{
+    Dna    *dna      = (Dna *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    int32  *nentries = (int32 *) PG_GETARG_POINTER(1);
+    KeyList list;
+    int     k;
+    int     w;
+
+    get_gin_options(fcinfo, &k, &w);
+    check_dna_consistency(dna);
+
+    list.n    = 0;
+    list.max  = (int32) Max(Min(dna->length, (uint32) 1 << 16), 16);
+    list.keys = (Datum *) palloc(sizeof(Datum) * list.max);
+
+    add_run_keys(&list, dna_code_at, dna, dna->length, k, w, w <= 1);
+
+    // GIN sorts the keys and drops the duplicates
+    *nentries = list.n;
+    PG_RETURN_POINTER(list.keys);
+}
+
+Datum
+dna_gin_extract_query(PG_FUNCTION_ARGS)
+{
+    int32          *nentries    = (int32 *) PG_GETARG_POINTER(1);
+    StrategyNumber  strategy    = PG_GETARG_UINT16(2);
+    bool          **partial     = (bool **) PG_GETARG_POINTER(3);
+    int32          *searchMode  = (int32 *) PG_GETARG_POINTER(6);
+    KeyList         list;
+    int             k;
+    int             w;
+
+    get_gin_options(fcinfo, &k, &w);
+
+    list.n    = 0;
+    list.max  = 16;
+    list.keys = (Datum *) palloc(sizeof(Datum) * list.max);
+
+    if (strategy == DNA_GIN_CONTAINS_KMER_STRATEGY)
+    {
+        Kmer query = PG_GETARG_KMER(0);
+        int  len   = kmer_length_internal(query);
+
+        if (len >= k)
+            add_run_keys(&list, kmer_code_at, &query, len, k, w, false);
+        else if (w <= 1)
+        {
+            // shorter than the keys: every key starting with the probe
+            list.keys[list.n++] = KmerGetDatum(query);
+            *partial = (bool *) palloc(sizeof(bool));
+            (*partial)[0] = true;
+        }
+    }
+    else if (strategy == DNA_GIN_CONTAINS_QKMER_STRATEGY)
+    {
+        QKmer *pattern = (QKmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+        int    len;
+        int    best_start = 0;
+        int    best_len = 0;
+        int    start = 0;
+
+        check_qkmer_consistency(pattern);
+        len = qkmer_length_internal(pattern);
+
+        // the unambiguous stretches of the pattern must occur in the sequence
+        for (int i = 0; i <= len; i++)
+        {
+            QKmerRun run = {pattern, start};
+
+            if (i < len && qkmer_get_code(pattern, i) >= 0)
+                continue;
+
+            if (i - start >= k)
+                add_run_keys(&list, qkmer_code_at, &run, i - start, k, w, false);
+            if (i - start > best_len)
+            {
+                best_start = start;
+                best_len   = i - start;
+            }
+            start = i + 1;
+        }
+
+        if (list.n == 0 && best_len > 0 && w <= 1)
+        {
+            Kmer prefix = 0;
+
+            for (int i = 0; i < best_len; i++)
+                prefix |= (uint64) qkmer_get_code(pattern, best_start + i) << KMER_BASE_SHIFT(i);
+            list.keys[list.n++] = KmerGetDatum(prefix | KMER_TERMINATOR(best_len));
+            *partial = (bool *) palloc(sizeof(bool));
+            (*partial)[0] = true;
+        }
+    }
+    else
+        elog(ERROR, "dna_gin_extract_query: unrecognized strategy number %d", strategy);
+
+    // nothing to look up: scan the whole index and recheck
+    if (list.n == 0)
+        *searchMode = GIN_SEARCH_MODE_ALL;
+
+    *nentries = list.n;
+    PG_RETURN_POINTER(list.keys);
+}
+
+// every key of the query must be present
+Datum
+dna_gin_consistent(PG_FUNCTION_ARGS)
+{
+    bool  *check    = (bool *) PG_GETARG_POINTER(0);
+    int32  nkeys    = PG_GETARG_INT32(3);
+    bool  *recheck  = (bool *) PG_GETARG_POINTER(5);
+
+    *recheck = true;
+
+    for (int i = 0; i < nkeys; i++)
+        if (!check[i])
+            PG_RETURN_BOOL(false);
+
+    PG_RETURN_BOOL(true);
+}
+
+Datum
+dna_gin_triconsistent(PG_FUNCTION_ARGS)
+{
+    GinTernaryValue *check = (GinTernaryValue *) PG_GETARG_POINTER(0);
+    int32            nkeys = PG_GETARG_INT32(3);
+
+    for (int i = 0; i < nkeys; i++)
+        if (check[i] == GIN_FALSE)
+            PG_RETURN_GIN_TERNARY_VALUE(GIN_FALSE);
+
+    // keys are never enough to prove containment
+    PG_RETURN_GIN_TERNARY_VALUE(GIN_MAYBE);
+}
+
+/*
+ * Partial match: the scan starts at the probe itself and the keys that
+ * extend it follow it directly in kmer order, so stop at the first key
+ * that does not start with the probe.
+ */
+Datum
+dna_gin_compare_partial(PG_FUNCTION_ARGS)
+{
+    Kmer probe = PG_GETARG_KMER(0);
+    Kmer key   = PG_GETARG_KMER(1);
+    int  np    = kmer_length_internal(probe);
+
+    if (kmer_length_internal(key) >= np && kmer_has_prefix_internal(key, probe, np))
+        PG_RETURN_INT32(0);
+
+    PG_RETURN_INT32(1);
+}
@@ -1,22 +1,94 @@
 #include "postgres.h"
 #include "fmgr.h"
-#include "common/hashfn.h"
+#include "utils/sortsupport.h"
 #include "kmer.h"
 
 PG_FUNCTION_INFO_V1(kmer_hash);
+PG_FUNCTION_INFO_V1(kmer_hash_extended);
+PG_FUNCTION_INFO_V1(kmer_sortsupport);
+PG_FUNCTION_INFO_V1(kmer_canonical_hash);
+PG_FUNCTION_INFO_V1(kmer_canonical_hash_extended);
 
-//Function that defines hashing of dna for grouping. Uses hash_bytes from postgres
+// Hash support for kmer_hash_ops (GROUP BY, DISTINCT, hash joins and indexes)
 
 Datum
 kmer_hash(PG_FUNCTION_ARGS)
 {
-    Kmer *k = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int packed_bytes = KMER_PACKED_BYTES(k->length);
+    Kmer k = PG_GETARG_KMER(0);
 
-    uint32 h = hash_bytes((unsigned char *) k->data, packed_bytes);
+    PG_RETURN_UINT32((uint32) kmer_hash_internal(k, 0));
+}
+
+// hash FUNCTION 2: seeded 64-bit hash, for hash partitioning
+Datum
+kmer_hash_extended(PG_FUNCTION_ARGS)
+{
+    Kmer k = PG_GETARG_KMER(0);
 
-    PG_RETURN_UINT32(h);
+    PG_RETURN_UINT64(kmer_hash_internal(k, (uint64) PG_GETARG_INT64(1)));
 }
 
+// hash of the canonical form, for kmer_canonical_hash_ops (~= as equality)
+Datum
+kmer_canonical_hash(PG_FUNCTION_ARGS)
+{
+    Kmer k = kmer_canonical_internal(PG_GETARG_KMER(0));
 
+    PG_RETURN_UINT32((uint32) kmer_hash_internal(k, 0));
+}
 
+Datum
+kmer_canonical_hash_extended(PG_FUNCTION_ARGS)
+{
+    Kmer k = kmer_canonical_internal(PG_GETARG_KMER(0));
+
+    PG_RETURN_UINT64(kmer_hash_internal(k, (uint64) PG_GETARG_INT64(1)));
+}
+
+
+// Native comparator used by tuplesort, bypassing fmgr
+static int
+kmer_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+    return kmer_cmp_internal(DatumGetKmer(x), DatumGetKmer(y));
+}
+
+/*
+ * Abbreviated key: the bases with the terminator cleared. Unsigned order
+ * of these words is the kmer order up to ties between a kmer and its
+ * A-padded extensions, which the full comparator resolves.
+ */
+static Datum
+kmer_abbrev_convert(Datum original, SortSupport ssup)
+{
+    Kmer k = DatumGetKmer(original);
+
+    return KmerGetDatum(k & (k - 1));
+}
+
+// The conversion is a single AND, never worth aborting
+static bool
+kmer_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+    return false;
+}
+
+// btree FUNCTION 2: sort support for kmer_btree_ops
+Datum
+kmer_sortsupport(PG_FUNCTION_ARGS)
+{
+    SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+    ssup->comparator = kmer_fastcmp;
+
+    if (ssup->abbreviate)
+    {
+        ssup->abbrev_full_comparator = kmer_fastcmp;
+        ssup->abbrev_converter       = kmer_abbrev_convert;
+        ssup->abbrev_abort           = kmer_abbrev_abort;
+        // lets tuplesort pick its specialized unsigned-key quicksort
+        ssup->comparator = ssup_datum_unsigned_cmp;
+    }
+
+    PG_RETURN_VOID();
+}
@@ -1,10 +1,7 @@
 #include "postgres.h"
-#if PG_VERSION_NUM >= 160000
-#include "varatt.h"
-#endif
 #include "fmgr.h"
+#include "libpq/pqformat.h"
 #include "utils/builtins.h"
-#include "utils/memutils.h"
 #include "kmer.h"
 
 #include <ctype.h>
@@ -14,6 +11,8 @@
 PG_FUNCTION_INFO_V1(kmer_in);
 PG_FUNCTION_INFO_V1(kmer_out);
 PG_FUNCTION_INFO_V1(kmer_length);
+PG_FUNCTION_INFO_V1(kmer_recv);
+PG_FUNCTION_INFO_V1(kmer_send);
 
 
 // Encode A/C/G/T into 0/1/2/3 
@@ -46,40 +45,24 @@ decode_base(unsigned char x)
     return table[x & 3];
 }
 
-// Compute logical number of bases stored in this kmer
-static inline int
-kmer_length_internal(const Kmer *k)
+// Ensure internal consistency (terminator present at a valid position)
+void
+check_kmer_consistency(Kmer k)
 {
-    return k->length;
-}
-
-// Ensure internal consistency (length <= 32, size matches packed length) 
-static void
-check_kmer_consistency(const Kmer *k)
-{
-    Size  size;
-    int   n;
-    Size  header;
-    Size  packed_bytes;
-    Size  min_size;
-
-    size = VARSIZE_ANY(k);
-    n    = k->length;
+    int tz;
 
-    if (n <= 0 || n > KMER_MAX_LENGTH)
+    if (k == 0)
         ereport(ERROR,
                 (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("kmer value has unreasonable length: %d", n)));
+                 errmsg("kmer value is corrupted: missing terminator")));
 
-    header       = offsetof(Kmer, data);
-    packed_bytes = KMER_PACKED_BYTES(n);
-    min_size     = header + packed_bytes;
-
-    if (size < min_size)
+    // terminator sits at bit 63-2n: odd position, n between 1 and 31
+    tz = pg_rightmost_one_pos64(k);
+    if ((tz & 1) == 0 || tz > 61)
         ereport(ERROR,
                 (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("kmer value is corrupted: size %zu too small for length %d",
-                        (size_t) size, n)));
+                 errmsg("kmer value has unreasonable length: %d",
+                        (63 - tz) >> 1)));
 }
 
 
@@ -90,10 +73,7 @@ kmer_in(PG_FUNCTION_ARGS)
 {
     char   *input;
     int     n;
-    Size    header;
-    Size    packed_bytes;
-    Size    size;
-    Kmer   *k;
+    Kmer    k;
 
     input = PG_GETARG_CSTRING(0);
     n     = (int) strlen(input);
@@ -108,30 +88,12 @@ kmer_in(PG_FUNCTION_ARGS)
                 (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
                  errmsg("kmer length %d exceeds maximum %d", n, KMER_MAX_LENGTH)));
 
-    header       = offsetof(Kmer, data);
-    packed_bytes = KMER_PACKED_BYTES(n);
-    size         = header + packed_bytes;
-
-    if (size > MaxAllocSize)
-        ereport(ERROR,
-                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
-                 errmsg("kmer is too large")));
-
-    k = (Kmer *) palloc0(size);
-    SET_VARSIZE(k, size);
-    k->length = n;
-
-    // Pack 4 bases per byte
+    // Pack bases from the top of the word down, then set the terminator
+    k = KMER_TERMINATOR(n);
     for (int i = 0; i < n; i++)
-    {
-        unsigned char v = encode_base(input[i]);
-        int           byte_index = i / 4;
-        int           shift      = (3 - (i % 4)) * 2;
-
-        k->data[byte_index] |= (unsigned char) (v << shift);
-    }
+        k |= (Kmer) encode_base(input[i]) << KMER_BASE_SHIFT(i);
 
-    PG_RETURN_POINTER(k);
+    PG_RETURN_KMER(k);
 }
 
 
@@ -139,41 +101,59 @@ kmer_in(PG_FUNCTION_ARGS)
 Datum
 kmer_out(PG_FUNCTION_ARGS)
 {
-    Kmer *k;
+    Kmer  k;
     int   n;
     char *res;
 
-    
-     //Use PG_DETOAST_DATUM to force a 4-byte header representation.
-     //Small values may be stored with a 1-byte varlena header, which would
-     //misalign the length field in our struct.
-     
-    k = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    k = PG_GETARG_KMER(0);
     check_kmer_consistency(k);
 
     n   = kmer_length_internal(k);
     res = (char *) palloc(n + 1);
 
     for (int i = 0; i < n; i++)
-    {
-        int           byte_index = i / 4;
-        int           shift      = (3 - (i % 4)) * 2;
-        unsigned char v         = (k->data[byte_index] >> shift) & 0x03;
-        res[i] = decode_base(v);
-    }
+        res[i] = decode_base((unsigned char) kmer_get_code(k, i));
     res[n] = '\0';
 
     PG_RETURN_CSTRING(res);
 }
 
 
+//Binary input: the packed word as an int64
+Datum
+kmer_recv(PG_FUNCTION_ARGS)
+{
+    StringInfo buf = (StringInfo) PG_GETARG_POINTER(0);
+    Kmer       k;
+
+    k = (Kmer) pq_getmsgint64(buf);
+    check_kmer_consistency(k);
+
+    PG_RETURN_KMER(k);
+}
+
+
+//Binary output: kmer -> bytea (8 bytes, network order)
+Datum
+kmer_send(PG_FUNCTION_ARGS)
+{
+    Kmer           k = PG_GETARG_KMER(0);
+    StringInfoData buf;
+
+    pq_begintypsend(&buf);
+    pq_sendint64(&buf, k);
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+
 Datum
 kmer_length(PG_FUNCTION_ARGS)
 {
-    Kmer *k;
-    int   n;
+    Kmer k;
+    int  n;
 
-    k = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    k = PG_GETARG_KMER(0);
     check_kmer_consistency(k);
 
     n = kmer_length_internal(k);
@@ -182,11 +162,7 @@ kmer_length(PG_FUNCTION_ARGS)
 }
 
 char
-kmer_get_base(const Kmer *k, int i)
+kmer_get_base(Kmer k, int i)
 {
-    int           byte_index = i / 4;
-    int           shift      = (3 - (i % 4)) * 2;
-    unsigned char v          = (k->data[byte_index] >> shift) & 0x03;
-    static const char table[4] = { 'A', 'C', 'G', 'T' };
-    return table[v];
-}
\ No newline at end of file
+    return decode_base((unsigned char) kmer_get_code(k, i));
+}
@@ -2,28 +2,209 @@
 #define KMER_H
 
 #include "postgres.h"
+#include "port/pg_bitutils.h"
+#include "port/pg_bswap.h"
 
-#define KMER_MAX_LENGTH 32
+/*
+ * kmer is a fixed-width, pass-by-value type stored in a single uint64:
+ *
+ *   bits 63 .. 64-2n   : n bases, 2 bits each (A=0, C=1, G=2, T=3),
+ *                        base 0 in the most significant bits
+ *   bit  63-2n         : terminator bit, always 1
+ *   lower bits         : zero
+ *
+ * The terminator is the lowest set bit, so the length is recovered from
+ * its position. 2n + 1 bits must fit in 64, hence k <= 31.
+ */
+#if SIZEOF_DATUM < 8
+#error "kmer is passed by value and requires 64-bit Datums"
+#endif
+
+// InitMaterializedSRF, ssup_datum_unsigned_cmp, MarkGUCPrefixReserved
+#if PG_VERSION_NUM < 150000
+#error "pg_dna requires PostgreSQL 15 or later"
+#endif
+
+#define KMER_MAX_LENGTH 31
+
+typedef uint64 Kmer;
+
+#define DatumGetKmer(X)     ((Kmer) DatumGetUInt64(X))
+#define KmerGetDatum(X)     UInt64GetDatum(X)
+#define PG_GETARG_KMER(n)   DatumGetKmer(PG_GETARG_DATUM(n))
+#define PG_RETURN_KMER(x)   return KmerGetDatum(x)
+
+// Terminator bit for a kmer of n bases
+#define KMER_TERMINATOR(n)  (UINT64CONST(1) << (63 - 2 * (n)))
+
+// Shift that brings base i down to bits 1..0
+#define KMER_BASE_SHIFT(i)  (62 - 2 * (i))
+
+// Number of bases stored in this kmer
+static inline int
+kmer_length_internal(Kmer k)
+{
+    return (63 - pg_rightmost_one_pos64(k)) >> 1;
+}
+
+// 2-bit code (0..3) of base i
+static inline int
+kmer_get_code(Kmer k, int i)
+{
+    return (int) ((k >> KMER_BASE_SHIFT(i)) & 0x03);
+}
+
+// Build a kmer from k bases held right-aligned in the low 2k bits of w
+static inline Kmer
+kmer_from_window(uint64 w, int k)
+{
+    return (w << (64 - 2 * k)) | KMER_TERMINATOR(k);
+}
+
+/*
+ * Word-at-a-time kernels shared by the operators, the opclass support
+ * functions and the SP-GiST callbacks.
+ *
+ * Clearing the terminator (the lowest set bit) leaves the bases padded
+ * with A (00). Since the packing is big-endian and A<C<G<T, comparing the
+ * padded words as integers orders kmers lexicographically; a tie means one
+ * is a prefix of the other padded with A, and the shorter one sorts first.
+ */
+static inline int
+kmer_cmp_internal(Kmer a, Kmer b)
+{
+    Kmer ba = a & (a - 1);
+    Kmer bb = b & (b - 1);
+
+    if (ba != bb)
+        return (ba < bb) ? -1 : 1;
+
+    // higher terminator bit = shorter kmer
+    if (a != b)
+        return (a > b) ? -1 : 1;
+
+    return 0;
+}
+
+// Same bases and same length: the words are identical
+static inline bool
+kmer_eq_internal(Kmer a, Kmer b)
+{
+    return a == b;
+}
+
+// Mask keeping the top n bases of a word (n in 1..31)
+static inline uint64
+kmer_prefix_mask(int n)
+{
+    return ~UINT64CONST(0) << (64 - 2 * n);
+}
 
-// Number of packed bytes needed for n characters (4 bases per byte)
-#define KMER_PACKED_BYTES(n) (((n) + 3) / 4)
+// Does value start with the first np bases of prefix? (caller checks np <= nv)
+static inline bool
+kmer_has_prefix_internal(Kmer value, Kmer prefix, int np)
+{
+    return ((value ^ prefix) & kmer_prefix_mask(np)) == 0;
+}
+
+// Number of positions among the first n bases where a and b differ
+static inline int
+kmer_mismatches_internal(Kmer a, Kmer b, int n)
+{
+    uint64 diff;
+
+    if (n == 0)
+        return 0;
+
+    // fold each differing 2-bit base onto its low bit, then count
+    diff = (a ^ b) & kmer_prefix_mask(n);
+    diff = (diff | (diff >> 1)) & UINT64CONST(0x5555555555555555);
+    return pg_popcount64(diff);
+}
 
 /*
- *   vl_len_ : standard PostgreSQL varlena length header
- *   length  : number of bases (1..32)
- *   data[]  : packed bases, 4 per byte (2 bits each)
+ * Hamming distance. Kmers of different lengths are compared as if the
+ * shorter one were padded with a symbol that matches no base, so every
+ * extra base counts as one mismatch (this keeps it a metric).
  */
-typedef struct Kmer
+static inline int
+kmer_hamming_internal(Kmer a, Kmer b)
 {
-    int32 vl_len_;
-    int32 length;                  // logical length in bases
-    unsigned char data[FLEXIBLE_ARRAY_MEMBER];
-} Kmer;
+    int la = kmer_length_internal(a);
+    int lb = kmer_length_internal(b);
+
+    return kmer_mismatches_internal(a, b, Min(la, lb)) + Abs(la - lb);
+}
+
+/*
+ * Reverse complement, on the packed word: complementing is code ^ 3
+ * (A<->T, C<->G), and reversing the order of the 2-bit groups is a swap
+ * of neighbouring groups, then of nibbles, then a byte swap. The n bases
+ * end up in the low 2n bits and are moved back to the top.
+ */
+static inline Kmer
+kmer_revcomp_internal(Kmer k)
+{
+    int    n = kmer_length_internal(k);
+    uint64 x;
+
+    if (n == 0)
+        return k;
+
+    x = (k & (k - 1)) ^ kmer_prefix_mask(n);
+    x = ((x >> 2) & UINT64CONST(0x3333333333333333)) | ((x & UINT64CONST(0x3333333333333333)) << 2);
+    x = ((x >> 4) & UINT64CONST(0x0F0F0F0F0F0F0F0F)) | ((x & UINT64CONST(0x0F0F0F0F0F0F0F0F)) << 4);
+    x = pg_bswap64(x);
+
+    return (x << (64 - 2 * n)) | KMER_TERMINATOR(n);
+}
+
+/*
+ * Canonical form: the smaller of a kmer and its reverse complement, so
+ * both strands of the same sequence map to one value. Same length, so
+ * comparing the words is the kmer order.
+ */
+static inline Kmer
+kmer_canonical_internal(Kmer k)
+{
+    Kmer rc = kmer_revcomp_internal(k);
+
+    return (rc < k) ? rc : k;
+}
+
+/*
+ * Hash of the packed word: the murmur3 64-bit finalizer, a bijection with
+ * full avalanche. The word already encodes the length (terminator bit),
+ * so AC and ACA hash differently. The seed is mixed the same way and
+ * XORed in first; seed 0 leaves the word unchanged, so the low 32 bits of
+ * the extended hash with seed 0 are the plain hash, as hash opclasses
+ * require.
+ */
+static inline uint64
+kmer_mix64(uint64 x)
+{
+    x ^= x >> 33;
+    x *= UINT64CONST(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64CONST(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64
+kmer_hash_internal(Kmer k, uint64 seed)
+{
+    return kmer_mix64(k ^ kmer_mix64(seed));
+}
 
 /* prototypes needed outside kmer.c */
 extern Datum kmer_in(PG_FUNCTION_ARGS);
 extern Datum kmer_out(PG_FUNCTION_ARGS);
 extern Datum kmer_length(PG_FUNCTION_ARGS);
-extern char kmer_get_base(const Kmer *k, int i);
+extern char kmer_get_base(Kmer k, int i);
+extern void check_kmer_consistency(Kmer k);
+
+/* funcs.c: k of the kmer generators, 1 .. KMER_MAX_LENGTH */
+extern void check_window_size(int32 k);
 
-#endif 
+#endif
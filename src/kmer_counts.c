@@ -0,0 +1,644 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "funcapi.h"
+#include "access/htup_details.h"
+#include "libpq/pqformat.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+#include "utils/typcache.h"
+
+#include "dna.h"
+#include "dna_reader.h"
+#include "kmer.h"
+
+/*
+ * kmer_counts(seq, k [, bin, bins]) to kmer_count[]: kmer frequencies
+ * over all the input sequences, sorted by kmer.
+ *
+ * The transition state is an open-addressing table (linear probing) of
+ * (kmer, count) slots, keyed on the packed word and kept in one memory
+ * context under the aggregate context. A kmer word is never 0 (it always
+ * has its terminator bit), so 0 marks an empty slot. Sequences are read
+ * packed byte by packed byte through a DnaReader; no kmer datum is built.
+ *
+ * The executor cannot spill a single aggregate state, so a spectrum too
+ * large for memory (or for one array) is split instead: with bins > 1
+ * only the kmers whose hash falls in bin are counted, and the bins are
+ * counted one after the other, each holding about 1/bins of the table.
+ */
+
+PG_FUNCTION_INFO_V1(kmer_counts_accum);
+PG_FUNCTION_INFO_V1(kmer_counts_combine);
+PG_FUNCTION_INFO_V1(kmer_counts_serialize);
+PG_FUNCTION_INFO_V1(kmer_counts_deserialize);
+PG_FUNCTION_INFO_V1(kmer_counts_final);
+PG_FUNCTION_INFO_V1(kmer_spectrum_accum);
+PG_FUNCTION_INFO_V1(kmer_spectrum_combine);
+PG_FUNCTION_INFO_V1(kmer_spectrum_serialize);
+PG_FUNCTION_INFO_V1(kmer_spectrum_deserialize);
+PG_FUNCTION_INFO_V1(kmer_spectrum_counts);
+
+#define KMER_COUNTS_MIN_SLOTS 1024
+
+typedef struct KmerCountSlot
+{
+    Kmer    kmer;       // 0 = empty
+    int64   count;
+} KmerCountSlot;
+
+typedef struct KmerCounts
+{
+    MemoryContext   mcxt;       // holds the state and its slots
+    int32           k;
+    int32           bin;
+    int32           bins;       // 1 = no binning
+    uint64          nslots;     // power of two
+    uint64          nused;
+    KmerCountSlot  *slots;
+} KmerCounts;
+
+static KmerCountSlot *
+slots_alloc(KmerCounts *counts, uint64 nslots)
+{
+    if (nslots > MaxAllocHugeSize / sizeof(KmerCountSlot))
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("kmer_counts: too many distinct kmers"),
+                 errhint("Split the count with kmer_counts(seq, k, bin, bins).")));
+
+    return (KmerCountSlot *) MemoryContextAllocExtended(counts->mcxt,
+                                                        nslots * sizeof(KmerCountSlot),
+                                                        MCXT_ALLOC_HUGE | MCXT_ALLOC_ZERO);
+}
+
+static KmerCounts *
+counts_create(MemoryContext aggcxt, int32 k, int32 bin, int32 bins, uint64 expected)
+{
+    MemoryContext mcxt;
+    KmerCounts   *counts;
+    uint64        nslots = KMER_COUNTS_MIN_SLOTS;
+
+    check_window_size(k);
+    if (bins <= 0 || bin < 0 || bin >= bins)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("kmer_counts: bin must be between 0 and bins - 1")));
+
+    // at most 3/4 full
+    while (nslots / 4 * 3 < expected)
+        nslots *= 2;
+
+    mcxt = AllocSetContextCreate(aggcxt, "kmer_counts", ALLOCSET_DEFAULT_SIZES);
+
+    counts = (KmerCounts *) MemoryContextAllocZero(mcxt, sizeof(KmerCounts));
+    counts->mcxt   = mcxt;
+    counts->k      = k;
+    counts->bin    = bin;
+    counts->bins   = bins;
+    counts->nslots = nslots;
+    counts->slots  = slots_alloc(counts, nslots);
+    return counts;
+}
+
+static inline void counts_insert(KmerCounts *counts, Kmer kmer, uint64 hash, int64 n);
+
+// double the table and reinsert every slot
+static void
+counts_grow(KmerCounts *counts)
+{
+    KmerCountSlot *old = counts->slots;
+    uint64         old_nslots = counts->nslots;
+
+    counts->nslots = old_nslots * 2;
+    counts->nused  = 0;
+    counts->slots  = slots_alloc(counts, counts->nslots);
+
+    for (uint64 i = 0; i < old_nslots; i++)
+        if (old[i].kmer != 0)
+            counts_insert(counts, old[i].kmer, kmer_hash_internal(old[i].kmer, 0),
+                          old[i].count);
+    pfree(old);
+}
+
+static inline void
+counts_insert(KmerCounts *counts, Kmer kmer, uint64 hash, int64 n)
+{
+    uint64 mask = counts->nslots - 1;
+    uint64 i = hash & mask;
+
+    for (;;)
+    {
+        KmerCountSlot *slot = &counts->slots[i];
+
+        if (slot->kmer == kmer)
+        {
+            slot->count += n;
+            return;
+        }
+        if (slot->kmer == 0)
+        {
+            slot->kmer  = kmer;
+            slot->count = n;
+            if (++counts->nused > counts->nslots / 4 * 3)
+                counts_grow(counts);
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+// count n more occurrences of kmer, if it belongs to this bin
+static inline void
+counts_add(KmerCounts *counts, Kmer kmer, int64 n)
+{
+    uint64 hash = kmer_hash_internal(kmer, 0);
+
+    // the slot uses the low bits, the bin the high ones
+    if (counts->bins > 1 && (uint32) (hash >> 32) % (uint32) counts->bins != (uint32) counts->bin)
+        return;
+    counts_insert(counts, kmer, hash, n);
+}
+
+typedef void (*WindowCallback) (void *arg, uint64 window);
+
+/*
+ * Roll a k-base window over the packed bytes and call emit with the window
+ * (right-aligned, 2 bits per base) at each base from base k-1 on. Inlined
+ * into both counters, so the call is direct.
+ */
+static inline void
+for_each_window(DnaReader *reader, int k, WindowCallback emit, void *arg)
+{
+    uint64  mask = (UINT64CONST(1) << (2 * k)) - 1;
+    uint64  window = 0;
+    uint64  pos = 0;
+    uint64  first = 0;
+
+    if (reader->length < (uint64) k)
+        return;
+
+    for (;;)
+    {
+        uint32               nbytes;
+        const unsigned char *bytes = dna_reader_chunk(reader, first, &nbytes);
+
+        if (bytes == NULL)
+            break;
+
+        for (uint32 b = 0; b < nbytes; b++)
+        {
+            for (int i = 0; i < 4 && pos < reader->length; i++, pos++)
+            {
+                window = ((window << 2) | ((bytes[b] >> (6 - 2 * i)) & 0x03)) & mask;
+                if (pos + 1 >= (uint64) k)
+                    emit(arg, window);
+            }
+        }
+        first += nbytes;
+    }
+}
+
+static void
+counts_add_window(void *arg, uint64 window)
+{
+    KmerCounts *counts = (KmerCounts *) arg;
+
+    counts_add(counts, kmer_from_window(window, counts->k), 1);
+}
+
+static void
+check_same_parameters(const KmerCounts *a, int32 k, int32 bin, int32 bins)
+{
+    if (a->k != k || a->bin != bin || a->bins != bins)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("kmer_counts: k, bin and bins must be the same for every row")));
+}
+
+static MemoryContext
+get_aggregate_context(FunctionCallInfo fcinfo, const char *name)
+{
+    MemoryContext aggcxt;
+
+    if (!AggCheckCallContext(fcinfo, &aggcxt))
+        elog(ERROR, "%s called in non-aggregate context", name);
+    return aggcxt;
+}
+
+// kmer_counts_accum(state, seq, k [, bin, bins]); rows with a NULL argument are skipped
+Datum
+kmer_counts_accum(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcxt = get_aggregate_context(fcinfo, "kmer_counts_accum");
+    KmerCounts   *counts = PG_ARGISNULL(0) ? NULL : (KmerCounts *) PG_GETARG_POINTER(0);
+    int32         k;
+    int32         bin  = 0;
+    int32         bins = 1;
+    DnaReader    *reader;
+
+    for (int i = 1; i < PG_NARGS(); i++)
+        if (PG_ARGISNULL(i))
+        {
+            if (counts == NULL)
+                PG_RETURN_NULL();
+            PG_RETURN_POINTER(counts);
+        }
+
+    k = PG_GETARG_INT32(2);
+    if (PG_NARGS() > 3)
+    {
+        bin  = PG_GETARG_INT32(3);
+        bins = PG_GETARG_INT32(4);
+    }
+
+    if (counts == NULL)
+        counts = counts_create(aggcxt, k, bin, bins, 0);
+    else
+        check_same_parameters(counts, k, bin, bins);
+
+    reader = dna_reader_open(PG_GETARG_DATUM(1));
+    for_each_window(reader, k, counts_add_window, counts);
+    dna_reader_close(reader);
+
+    PG_RETURN_POINTER(counts);
+}
+
+// merge the partial counts of two workers
+Datum
+kmer_counts_combine(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcxt = get_aggregate_context(fcinfo, "kmer_counts_combine");
+    KmerCounts   *a = PG_ARGISNULL(0) ? NULL : (KmerCounts *) PG_GETARG_POINTER(0);
+    KmerCounts   *b = PG_ARGISNULL(1) ? NULL : (KmerCounts *) PG_GETARG_POINTER(1);
+
+    if (b == NULL)
+    {
+        if (a == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(a);
+    }
+
+    // b may live in another context: copy it into ours
+    if (a == NULL)
+        a = counts_create(aggcxt, b->k, b->bin, b->bins, b->nused);
+    else
+        check_same_parameters(a, b->k, b->bin, b->bins);
+
+    for (uint64 i = 0; i < b->nslots; i++)
+        if (b->slots[i].kmer != 0)
+            counts_insert(a, b->slots[i].kmer, kmer_hash_internal(b->slots[i].kmer, 0),
+                          b->slots[i].count);
+
+    PG_RETURN_POINTER(a);
+}
+
+/*
+ * Serialized state: k, bin, bins (int32), the number of entries (int64),
+ * then (kmer, count) pairs as int64, in table order.
+ */
+Datum
+kmer_counts_serialize(PG_FUNCTION_ARGS)
+{
+    KmerCounts    *counts = (KmerCounts *) PG_GETARG_POINTER(0);
+    StringInfoData buf;
+
+    if (counts->nused > (MaxAllocSize - 64) / (2 * sizeof(int64)))
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("kmer_counts: %llu distinct kmers do not fit in one partial result",
+                        (unsigned long long) counts->nused),
+                 errhint("Split the count with kmer_counts(seq, k, bin, bins).")));
+
+    pq_begintypsend(&buf);
+    enlargeStringInfo(&buf, (int) (counts->nused * 2 * sizeof(int64)) + 32);
+
+    pq_sendint32(&buf, counts->k);
+    pq_sendint32(&buf, counts->bin);
+    pq_sendint32(&buf, counts->bins);
+    pq_sendint64(&buf, (int64) counts->nused);
+
+    for (uint64 i = 0; i < counts->nslots; i++)
+        if (counts->slots[i].kmer != 0)
+        {
+            pq_sendint64(&buf, (int64) counts->slots[i].kmer);
+            pq_sendint64(&buf, counts->slots[i].count);
+        }
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+Datum
+kmer_counts_deserialize(PG_FUNCTION_ARGS)
+{
+    MemoryContext  aggcxt = get_aggregate_context(fcinfo, "kmer_counts_deserialize");
+    bytea         *data = PG_GETARG_BYTEA_PP(0);
+    StringInfoData buf;
+    KmerCounts    *counts;
+    int32          k;
+    int32          bin;
+    int32          bins;
+    int64          n;
+
+    // read in place, the pq_getmsg functions never write to the buffer
+    buf.data   = VARDATA_ANY(data);
+    buf.len    = VARSIZE_ANY_EXHDR(data);
+    buf.maxlen = buf.len;
+    buf.cursor = 0;
+
+    k    = pq_getmsgint(&buf, 4);
+    bin  = pq_getmsgint(&buf, 4);
+    bins = pq_getmsgint(&buf, 4);
+    n    = pq_getmsgint64(&buf);
+
+    if (n < 0 || (uint64) n > (uint64) (buf.len - buf.cursor) / (2 * sizeof(int64)))
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("kmer_counts: invalid serialized state")));
+
+    counts = counts_create(aggcxt, k, bin, bins, (uint64) n);
+
+    for (int64 i = 0; i < n; i++)
+    {
+        Kmer  kmer  = (Kmer) pq_getmsgint64(&buf);
+        int64 count = pq_getmsgint64(&buf);
+
+        counts_insert(counts, kmer, kmer_hash_internal(kmer, 0), count);
+    }
+    pq_getmsgend(&buf);
+
+    PG_RETURN_POINTER(counts);
+}
+
+static int
+kmer_word_cmp(const void *a, const void *b)
+{
+    Kmer ka = ((const KmerCountSlot *) a)->kmer;
+    Kmer kb = ((const KmerCountSlot *) b)->kmer;
+
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+ * Final: the entries as a kmer_count[] sorted by kmer. All kmers have the
+ * same length, so word order is kmer order. The state is left untouched
+ * (the entries are copied before sorting), as final functions may run
+ * more than once over a shared state.
+ */
+Datum
+kmer_counts_final(PG_FUNCTION_ARGS)
+{
+    KmerCounts    *counts;
+    KmerCountSlot *entries;
+    Datum         *elems;
+    Oid            elemtype;
+    TupleDesc      tupdesc;
+    int16          typlen;
+    bool           typbyval;
+    char           typalign;
+    uint64         n = 0;
+    ArrayType     *result;
+
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+    counts = (KmerCounts *) PG_GETARG_POINTER(0);
+
+    if (counts->nused > MaxAllocSize / 64)
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("kmer_counts: %llu distinct kmers do not fit in one array",
+                        (unsigned long long) counts->nused),
+                 errhint("Split the count with kmer_counts(seq, k, bin, bins).")));
+
+    elemtype = get_element_type(get_fn_expr_rettype(fcinfo->flinfo));
+    if (!OidIsValid(elemtype))
+        elog(ERROR, "kmer_counts_final: could not determine the result element type");
+    tupdesc = lookup_rowtype_tupdesc_copy(elemtype, -1);
+    get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+
+    entries = (KmerCountSlot *) palloc(Max(counts->nused, 1) * sizeof(KmerCountSlot));
+    for (uint64 i = 0; i < counts->nslots; i++)
+        if (counts->slots[i].kmer != 0)
+            entries[n++] = counts->slots[i];
+    qsort(entries, n, sizeof(KmerCountSlot), kmer_word_cmp);
+
+    elems = (Datum *) palloc(Max(n, 1) * sizeof(Datum));
+    for (uint64 i = 0; i < n; i++)
+    {
+        Datum values[2];
+        bool  nulls[2] = {false, false};
+
+        values[0] = KmerGetDatum(entries[i].kmer);
+        values[1] = Int64GetDatum(entries[i].count);
+        elems[i]  = HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls));
+    }
+
+    result = construct_array(elems, (int) n, elemtype, typlen, typbyval, typalign);
+    PG_RETURN_ARRAYTYPE_P(result);
+}
+
+
+/*
+ * kmer_spectrum(seq, k) to bytea: dense counts for small k (k <= 12).
+ *
+ * The state is a flat array of 4^k uint32 counters indexed by the window
+ * itself (the 2k-bit code of the kmer), so counting is one increment per
+ * base, with no hashing or probing. Partial spectra are combined by adding
+ * the arrays.
+ *
+ * Spectrum format, also used for the serialized state: k as int32, then
+ * the 4^k counts as uint32, in kmer order, all in network byte order.
+ * kmer_spectrum_counts() unnests it into (kmer, count) rows.
+ */
+#define KMER_SPECTRUM_MAX_K 12
+
+typedef struct KmerSpectrum
+{
+    int32   k;
+    uint64  size;                               // 4^k
+    uint32  counts[FLEXIBLE_ARRAY_MEMBER];
+} KmerSpectrum;
+
+static KmerSpectrum *
+spectrum_create(MemoryContext mcxt, int32 k)
+{
+    KmerSpectrum *spectrum;
+    uint64        size;
+
+    check_window_size(k);
+    if (k > KMER_SPECTRUM_MAX_K)
+        ereport(ERROR,
+                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+                 errmsg("kmer_spectrum: k %d exceeds maximum %d", k, KMER_SPECTRUM_MAX_K),
+                 errhint("Use kmer_counts() for longer kmers.")));
+
+    size = UINT64CONST(1) << (2 * k);
+    spectrum = (KmerSpectrum *) MemoryContextAllocZero(mcxt,
+                                                       offsetof(KmerSpectrum, counts) +
+                                                       size * sizeof(uint32));
+    spectrum->k    = k;
+    spectrum->size = size;
+    return spectrum;
+}
+
+static inline void
+spectrum_add(KmerSpectrum *spectrum, uint64 index, uint32 n)
+{
+    uint32 sum = spectrum->counts[index] + n;
+
+    if (unlikely(sum < n))
+        ereport(ERROR,
+                (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                 errmsg("kmer_spectrum: count of a kmer exceeds %u", PG_UINT32_MAX),
+                 errhint("Use kmer_counts(), which counts in bigint.")));
+    spectrum->counts[index] = sum;
+}
+
+static void
+spectrum_add_window(void *arg, uint64 window)
+{
+    spectrum_add((KmerSpectrum *) arg, window, 1);
+}
+
+// k of a spectrum value, after checking its size
+static int32
+spectrum_check(bytea *value)
+{
+    Size    len = VARSIZE_ANY_EXHDR(value);
+    uint32  k;
+
+    if (len >= sizeof(uint32))
+    {
+        memcpy(&k, VARDATA_ANY(value), sizeof(uint32));
+        k = pg_ntoh32(k);
+        if (k >= 1 && k <= KMER_SPECTRUM_MAX_K &&
+            len == sizeof(uint32) * (1 + (UINT64CONST(1) << (2 * k))))
+            return (int32) k;
+    }
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+             errmsg("invalid kmer spectrum")));
+    return 0;
+}
+
+// kmer_spectrum_accum(state, seq, k); rows with a NULL argument are skipped
+Datum
+kmer_spectrum_accum(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcxt = get_aggregate_context(fcinfo, "kmer_spectrum_accum");
+    KmerSpectrum *spectrum = PG_ARGISNULL(0) ? NULL : (KmerSpectrum *) PG_GETARG_POINTER(0);
+    DnaReader    *reader;
+    int32         k;
+
+    if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+    {
+        if (spectrum == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(spectrum);
+    }
+
+    k = PG_GETARG_INT32(2);
+    if (spectrum == NULL)
+        spectrum = spectrum_create(aggcxt, k);
+    else if (spectrum->k != k)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("kmer_spectrum: k must be the same for every row")));
+
+    reader = dna_reader_open(PG_GETARG_DATUM(1));
+    for_each_window(reader, k, spectrum_add_window, spectrum);
+    dna_reader_close(reader);
+
+    PG_RETURN_POINTER(spectrum);
+}
+
+Datum
+kmer_spectrum_combine(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcxt = get_aggregate_context(fcinfo, "kmer_spectrum_combine");
+    KmerSpectrum *a = PG_ARGISNULL(0) ? NULL : (KmerSpectrum *) PG_GETARG_POINTER(0);
+    KmerSpectrum *b = PG_ARGISNULL(1) ? NULL : (KmerSpectrum *) PG_GETARG_POINTER(1);
+
+    if (b == NULL)
+    {
+        if (a == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(a);
+    }
+
+    if (a == NULL)
+        a = spectrum_create(aggcxt, b->k);
+    else if (a->k != b->k)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("kmer_spectrum: k must be the same for every row")));
+
+    for (uint64 i = 0; i < b->size; i++)
+        spectrum_add(a, i, b->counts[i]);
+
+    PG_RETURN_POINTER(a);
+}
+
+// serial function, and final function: the state as a spectrum value
+Datum
+kmer_spectrum_serialize(PG_FUNCTION_ARGS)
+{
+    KmerSpectrum *spectrum = (KmerSpectrum *) PG_GETARG_POINTER(0);
+    Size          len = sizeof(uint32) * (1 + spectrum->size);
+    bytea        *result = (bytea *) palloc(VARHDRSZ + len);
+    uint32       *out = (uint32 *) VARDATA(result);
+
+    SET_VARSIZE(result, VARHDRSZ + len);
+    out[0] = pg_hton32((uint32) spectrum->k);
+    for (uint64 i = 0; i < spectrum->size; i++)
+        out[i + 1] = pg_hton32(spectrum->counts[i]);
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+Datum
+kmer_spectrum_deserialize(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcxt = get_aggregate_context(fcinfo, "kmer_spectrum_deserialize");
+    bytea        *value = PG_GETARG_BYTEA_P(0);
+    int32         k = spectrum_check(value);
+    KmerSpectrum *spectrum = spectrum_create(aggcxt, k);
+    const uint32 *in = (const uint32 *) VARDATA(value);
+
+    for (uint64 i = 0; i < spectrum->size; i++)
+        spectrum->counts[i] = pg_ntoh32(in[i + 1]);
+
+    PG_RETURN_POINTER(spectrum);
+}
+
+// kmer_spectrum_counts(spectrum) to SETOF (kmer, count): the non-zero counts, in kmer order
+Datum
+kmer_spectrum_counts(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    bytea         *value = PG_GETARG_BYTEA_P(0);
+    int32          k = spectrum_check(value);
+    uint64         size = UINT64CONST(1) << (2 * k);
+    const uint32  *in = (const uint32 *) VARDATA(value);
+    Datum          values[2];
+    bool           nulls[2] = {false, false};
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    for (uint64 i = 0; i < size; i++)
+    {
+        uint32 count = pg_ntoh32(in[i + 1]);
+
+        if (count == 0)
+            continue;
+        values[0] = KmerGetDatum(kmer_from_window(i, k));
+        values[1] = Int64GetDatum((int64) count);
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
@@ -0,0 +1,534 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "access/htup_details.h"
+#include "catalog/pg_statistic.h"
+#include "commands/vacuum.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+
+#include "kmer.h"
+#include "qkmer.h"
+
+#include <math.h>
+
+/*
+ * ANALYZE support and selectivity estimators for the kmer operators.
+ *
+ * kmer_typanalyze keeps the standard statistics (most common values, a
+ * histogram in kmer order and n_distinct, which eqsel and the range
+ * estimators use) and adds one slot of base statistics: the fraction of
+ * values of each length, and the frequency of each base at each position.
+ *
+ * Because kmers sort lexicographically, the values starting with a given
+ * prefix are one run of the histogram; the histogram bounds in that run
+ * bracket the fraction of matching values to within a bucket. Inside the
+ * bracket the estimate comes from the base statistics, treating positions
+ * as independent: a prefix is the product of the frequencies of its bases,
+ * and an IUPAC pattern the product, over its positions, of the summed
+ * frequencies of the bases it accepts. This keeps rare patterns well below
+ * the resolution of the histogram, and degenerate ones close to 1.
+ */
+
+PG_FUNCTION_INFO_V1(kmer_typanalyze);
+PG_FUNCTION_INFO_V1(kmer_prefix_sel);
+PG_FUNCTION_INFO_V1(kmer_prefix_joinsel);
+PG_FUNCTION_INFO_V1(qkmer_contains_sel);
+PG_FUNCTION_INFO_V1(kmer_contained_sel);
+
+/*
+ * pg_statistic kind of the base statistics slot, from the range reserved
+ * for private use. stanumbers holds KMER_STATS_NUMBERS values: the length
+ * fractions for lengths 0 .. KMER_MAX_LENGTH, then, for each position, the
+ * frequencies of A, C, G and T among the values long enough to have it.
+ */
+#define STATISTIC_KIND_KMER_BASES   10031
+
+#define KMER_STATS_LENGTHS          (KMER_MAX_LENGTH + 1)
+#define KMER_STATS_NUMBERS          (KMER_STATS_LENGTHS + 4 * KMER_MAX_LENGTH)
+
+typedef struct KmerBaseStats
+{
+    bool    lengths_known;                       // false: no statistics, lengths not modelled
+    float4  length_frac[KMER_STATS_LENGTHS];     // fraction of the non-null values of each length
+    float4  base_frac[KMER_MAX_LENGTH][4];       // base frequencies at each position
+} KmerBaseStats;
+
+typedef struct KmerAnalyzeExtraData
+{
+    AnalyzeAttrComputeStatsFunc std_compute_stats;
+    void       *std_extra_data;
+} KmerAnalyzeExtraData;
+
+typedef enum KmerSelKind
+{
+    KMER_SEL_PREFIX,        // column ^@ const
+    KMER_SEL_PREFIX_OF,     // const ^@ column
+    KMER_SEL_PATTERN        // column <@ qkmer, qkmer @> column
+} KmerSelKind;
+
+typedef struct KmerSelQuery
+{
+    KmerSelKind  kind;
+    Kmer         kmer;      // prefix or value, for the prefix kinds
+    const QKmer *pattern;   // for KMER_SEL_PATTERN
+} KmerSelQuery;
+
+
+/*
+ * ANALYZE
+ */
+
+static void
+compute_kmer_stats(VacAttrStats *stats, AnalyzeAttrFetchFunc fetchfunc,
+                   int samplerows, double totalrows)
+{
+    KmerAnalyzeExtraData *extra = (KmerAnalyzeExtraData *) stats->extra_data;
+    double        length_count[KMER_STATS_LENGTHS] = {0};
+    double        base_count[KMER_MAX_LENGTH][4] = {{0}};
+    double        nonnull = 0;
+    double        reached;
+    float4       *numbers;
+    MemoryContext old;
+    int           slot;
+
+    // the standard statistics first, with their own extra data
+    stats->extra_data = extra->std_extra_data;
+    extra->std_compute_stats(stats, fetchfunc, samplerows, totalrows);
+    stats->extra_data = extra;
+
+    if (!stats->stats_valid)
+        return;
+
+    for (int i = 0; i < samplerows; i++)
+    {
+        bool isnull;
+        Kmer k;
+        int  n;
+
+#if PG_VERSION_NUM >= 180000
+        vacuum_delay_point(true);
+#else
+        vacuum_delay_point();
+#endif
+
+        k = DatumGetKmer(fetchfunc(stats, i, &isnull));
+        if (isnull)
+            continue;
+
+        n = kmer_length_internal(k);
+        length_count[n]++;
+        for (int j = 0; j < n; j++)
+            base_count[j][kmer_get_code(k, j)]++;
+        nonnull++;
+    }
+    if (nonnull == 0)
+        return;
+
+    for (slot = 0; slot < STATISTIC_NUM_SLOTS; slot++)
+        if (stats->stakind[slot] == 0)
+            break;
+    if (slot == STATISTIC_NUM_SLOTS)
+        return;
+
+    old = MemoryContextSwitchTo(stats->anl_context);
+    numbers = (float4 *) palloc(KMER_STATS_NUMBERS * sizeof(float4));
+    MemoryContextSwitchTo(old);
+
+    for (int n = 0; n < KMER_STATS_LENGTHS; n++)
+        numbers[n] = length_count[n] / nonnull;
+
+    /*
+     * A base missing from the sample is rare, not impossible: each count
+     * gets a quarter of a pseudo-observation so no frequency is 0.
+     */
+    reached = nonnull - length_count[0];
+    for (int j = 0; j < KMER_MAX_LENGTH; j++)
+    {
+        for (int c = 0; c < 4; c++)
+            numbers[KMER_STATS_LENGTHS + 4 * j + c] = (base_count[j][c] + 0.25) / (reached + 1.0);
+        reached -= length_count[j + 1];
+    }
+
+    stats->stakind[slot] = STATISTIC_KIND_KMER_BASES;
+    stats->staop[slot] = InvalidOid;
+    stats->stacoll[slot] = InvalidOid;
+    stats->stanumbers[slot] = numbers;
+    stats->numnumbers[slot] = KMER_STATS_NUMBERS;
+    stats->stavalues[slot] = NULL;
+    stats->numvalues[slot] = 0;
+}
+
+
+Datum
+kmer_typanalyze(PG_FUNCTION_ARGS)
+{
+    VacAttrStats         *stats = (VacAttrStats *) PG_GETARG_POINTER(0);
+    KmerAnalyzeExtraData *extra;
+
+    if (!std_typanalyze(stats))
+        PG_RETURN_BOOL(false);
+
+    extra = (KmerAnalyzeExtraData *) palloc(sizeof(KmerAnalyzeExtraData));
+    extra->std_compute_stats = stats->compute_stats;
+    extra->std_extra_data = stats->extra_data;
+
+    stats->extra_data = extra;
+    stats->compute_stats = compute_kmer_stats;
+
+    PG_RETURN_BOOL(true);
+}
+
+
+/*
+ * Base statistics
+ */
+
+// without statistics: uniform bases, lengths not modelled
+static void
+kmer_base_stats_uniform(KmerBaseStats *bs)
+{
+    bs->lengths_known = false;
+    for (int j = 0; j < KMER_MAX_LENGTH; j++)
+        for (int c = 0; c < 4; c++)
+            bs->base_frac[j][c] = 0.25;
+}
+
+static void
+kmer_base_stats_fetch(VariableStatData *vardata, KmerBaseStats *bs)
+{
+    AttStatsSlot sslot;
+
+    if (!HeapTupleIsValid(vardata->statsTuple) ||
+        !get_attstatsslot(&sslot, vardata->statsTuple, STATISTIC_KIND_KMER_BASES,
+                          InvalidOid, ATTSTATSSLOT_NUMBERS))
+    {
+        kmer_base_stats_uniform(bs);
+        return;
+    }
+
+    if (sslot.nnumbers != KMER_STATS_NUMBERS)
+        kmer_base_stats_uniform(bs);
+    else
+    {
+        bs->lengths_known = true;
+        memcpy(bs->length_frac, sslot.numbers, sizeof(bs->length_frac));
+        memcpy(bs->base_frac, sslot.numbers + KMER_STATS_LENGTHS, sizeof(bs->base_frac));
+    }
+    free_attstatsslot(&sslot);
+}
+
+// fraction of the values of at least n bases
+static double
+kmer_length_at_least(const KmerBaseStats *bs, int n)
+{
+    double frac = 0;
+
+    if (!bs->lengths_known)
+        return 1.0;
+    for (int m = n; m < KMER_STATS_LENGTHS; m++)
+        frac += bs->length_frac[m];
+    return frac;
+}
+
+// fraction of the non-null values that match, positions taken as independent
+static double
+kmer_sel_model(const KmerSelQuery *q, const KmerBaseStats *bs)
+{
+    double sel;
+    double bases;
+    int    n;
+
+    switch (q->kind)
+    {
+        case KMER_SEL_PREFIX:
+            n = kmer_length_internal(q->kmer);
+            sel = kmer_length_at_least(bs, n);
+            for (int j = 0; j < n; j++)
+                sel *= bs->base_frac[j][kmer_get_code(q->kmer, j)];
+            return sel;
+
+        case KMER_SEL_PREFIX_OF:
+            // sum over the lengths m <= n of the values equal to the first m bases
+            n = kmer_length_internal(q->kmer);
+            if (!bs->lengths_known)
+            {
+                sel = 1.0;
+                for (int j = 0; j < n; j++)
+                    sel *= bs->base_frac[j][kmer_get_code(q->kmer, j)];
+                return sel;
+            }
+            sel = bs->length_frac[0];
+            bases = 1.0;
+            for (int j = 0; j < n; j++)
+            {
+                bases *= bs->base_frac[j][kmer_get_code(q->kmer, j)];
+                sel += bs->length_frac[j + 1] * bases;
+            }
+            return sel;
+
+        case KMER_SEL_PATTERN:
+            n = qkmer_length_internal(q->pattern);
+            if (n > KMER_MAX_LENGTH)
+                return 0.0;
+            sel = bs->lengths_known ? bs->length_frac[n] : 1.0;
+            for (int j = 0; j < n; j++)
+            {
+                int set = qkmer_get_set(q->pattern, j);
+
+                bases = 0;
+                for (int c = 0; c < 4; c++)
+                    if (set & (1 << c))
+                        bases += bs->base_frac[j][c];
+                sel *= bases;
+            }
+            return sel;
+    }
+    return 0.0;
+}
+
+// the operator, without its errors on length mismatches
+static bool
+kmer_sel_matches(const KmerSelQuery *q, Kmer value)
+{
+    int n;
+
+    switch (q->kind)
+    {
+        case KMER_SEL_PREFIX:
+            n = kmer_length_internal(q->kmer);
+            return n == 0 ||
+                (n <= kmer_length_internal(value) && kmer_has_prefix_internal(value, q->kmer, n));
+
+        case KMER_SEL_PREFIX_OF:
+            n = kmer_length_internal(value);
+            return n == 0 ||
+                (n <= kmer_length_internal(q->kmer) && kmer_has_prefix_internal(q->kmer, value, n));
+
+        case KMER_SEL_PATTERN:
+            return qkmer_matches_kmer(q->pattern, value);
+    }
+    return false;
+}
+
+
+/*
+ * Restriction estimate from the statistics of the column. The most common
+ * values are tested directly. For the rest, m matching histogram bounds
+ * out of n bound the matching fraction: for a prefix they are one run
+ * spanning m - 1 to m + 1 of the n - 1 buckets, otherwise they are a sample
+ * of the values. The base statistics choose within those bounds.
+ */
+static double
+kmer_sel_estimate(VariableStatData *vardata, const KmerSelQuery *q)
+{
+    KmerBaseStats bs;
+    AttStatsSlot  sslot;
+    double        nullfrac;
+    double        mcv_sel = 0;
+    double        sumcommon = 0;
+    double        rest;
+    double        sel;
+
+    kmer_base_stats_fetch(vardata, &bs);
+    rest = kmer_sel_model(q, &bs);
+
+    if (!HeapTupleIsValid(vardata->statsTuple))
+    {
+        sel = rest;
+        CLAMP_PROBABILITY(sel);
+        return sel;
+    }
+    nullfrac = ((Form_pg_statistic) GETSTRUCT(vardata->statsTuple))->stanullfrac;
+
+    if (get_attstatsslot(&sslot, vardata->statsTuple, STATISTIC_KIND_MCV, InvalidOid,
+                         ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+    {
+        for (int i = 0; i < sslot.nvalues; i++)
+        {
+            sumcommon += sslot.numbers[i];
+            if (kmer_sel_matches(q, DatumGetKmer(sslot.values[i])))
+                mcv_sel += sslot.numbers[i];
+        }
+        free_attstatsslot(&sslot);
+    }
+
+    if (get_attstatsslot(&sslot, vardata->statsTuple, STATISTIC_KIND_HISTOGRAM, InvalidOid,
+                         ATTSTATSSLOT_VALUES))
+    {
+        if (sslot.nvalues >= 2)
+        {
+            double span = (q->kind == KMER_SEL_PREFIX) ? sslot.nvalues - 1 : sslot.nvalues;
+            int    m = 0;
+
+            for (int i = 0; i < sslot.nvalues; i++)
+                if (kmer_sel_matches(q, DatumGetKmer(sslot.values[i])))
+                    m++;
+
+            rest = Max(rest, Max(m - 1, 0) / span);
+            rest = Min(rest, Min(m + 1, span) / span);
+        }
+        free_attstatsslot(&sslot);
+    }
+
+    sel = mcv_sel + rest * Max(1.0 - nullfrac - sumcommon, 0.0);
+    CLAMP_PROBABILITY(sel);
+    return sel;
+}
+
+
+// kmer ^@ kmer
+Datum
+kmer_prefix_sel(PG_FUNCTION_ARGS)
+{
+    PlannerInfo     *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List            *args = (List *) PG_GETARG_POINTER(2);
+    int              varRelid = PG_GETARG_INT32(3);
+    VariableStatData vardata;
+    Node            *other;
+    bool             varonleft;
+    KmerSelQuery     q;
+    double           sel;
+
+    if (!get_restriction_variable(root, args, varRelid, &vardata, &other, &varonleft))
+        PG_RETURN_FLOAT8(DEFAULT_MATCH_SEL);
+
+    if (!IsA(other, Const))
+    {
+        ReleaseVariableStats(vardata);
+        PG_RETURN_FLOAT8(DEFAULT_MATCH_SEL);
+    }
+    if (((Const *) other)->constisnull)
+    {
+        ReleaseVariableStats(vardata);
+        PG_RETURN_FLOAT8(0.0);
+    }
+
+    q.kind = varonleft ? KMER_SEL_PREFIX : KMER_SEL_PREFIX_OF;
+    q.kmer = DatumGetKmer(((Const *) other)->constvalue);
+    q.pattern = NULL;
+
+    sel = kmer_sel_estimate(&vardata, &q);
+
+    ReleaseVariableStats(vardata);
+    PG_RETURN_FLOAT8(sel);
+}
+
+
+// kmer <@ qkmer and qkmer @> kmer; no statistics are kept on qkmer columns
+static double
+kmer_pattern_sel(FunctionCallInfo fcinfo, bool kmer_on_left)
+{
+    PlannerInfo     *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List            *args = (List *) PG_GETARG_POINTER(2);
+    int              varRelid = PG_GETARG_INT32(3);
+    VariableStatData vardata;
+    Node            *other;
+    bool             varonleft;
+    KmerSelQuery     q;
+    double           sel;
+
+    if (!get_restriction_variable(root, args, varRelid, &vardata, &other, &varonleft))
+        return DEFAULT_MATCHING_SEL;
+
+    if (varonleft != kmer_on_left || !IsA(other, Const))
+    {
+        ReleaseVariableStats(vardata);
+        return DEFAULT_MATCHING_SEL;
+    }
+    if (((Const *) other)->constisnull)
+    {
+        ReleaseVariableStats(vardata);
+        return 0.0;
+    }
+
+    q.kind = KMER_SEL_PATTERN;
+    q.kmer = 0;
+    q.pattern = (QKmer *) PG_DETOAST_DATUM(((Const *) other)->constvalue);
+    check_qkmer_consistency(q.pattern);
+
+    sel = kmer_sel_estimate(&vardata, &q);
+
+    ReleaseVariableStats(vardata);
+    return sel;
+}
+
+Datum
+qkmer_contains_sel(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_FLOAT8(kmer_pattern_sel(fcinfo, false));
+}
+
+Datum
+kmer_contained_sel(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_FLOAT8(kmer_pattern_sel(fcinfo, true));
+}
+
+
+/*
+ * value ^@ prefix between two kmer columns: the chance that a random
+ * value starts with a random prefix, summed over the prefix lengths. A
+ * semi or anti join needs the chance that an outer value matches any of
+ * the distinct inner ones instead.
+ */
+Datum
+kmer_prefix_joinsel(PG_FUNCTION_ARGS)
+{
+    PlannerInfo      *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List             *args = (List *) PG_GETARG_POINTER(2);
+    JoinType          jointype = (JoinType) PG_GETARG_INT16(3);
+    SpecialJoinInfo  *sjinfo = (SpecialJoinInfo *) PG_GETARG_POINTER(4);
+    VariableStatData  vardata1;
+    VariableStatData  vardata2;
+    bool              join_is_reversed;
+    KmerBaseStats     values;
+    KmerBaseStats     prefixes;
+    double            sel = 0;
+    double            bases = 1.0;
+
+    get_join_variables(root, args, sjinfo, &vardata1, &vardata2, &join_is_reversed);
+
+    kmer_base_stats_fetch(&vardata1, &values);
+    kmer_base_stats_fetch(&vardata2, &prefixes);
+
+    if (!values.lengths_known || !prefixes.lengths_known)
+        sel = DEFAULT_MATCH_SEL;
+    else
+    {
+        for (int n = 0; n < KMER_STATS_LENGTHS; n++)
+        {
+            if (n > 0)
+            {
+                double same = 0;
+
+                for (int c = 0; c < 4; c++)
+                    same += values.base_frac[n - 1][c] * prefixes.base_frac[n - 1][c];
+                bases *= same;
+            }
+            sel += prefixes.length_frac[n] * kmer_length_at_least(&values, n) * bases;
+        }
+
+        if (HeapTupleIsValid(vardata1.statsTuple))
+            sel *= 1.0 - ((Form_pg_statistic) GETSTRUCT(vardata1.statsTuple))->stanullfrac;
+        if (HeapTupleIsValid(vardata2.statsTuple))
+            sel *= 1.0 - ((Form_pg_statistic) GETSTRUCT(vardata2.statsTuple))->stanullfrac;
+
+        if (jointype == JOIN_SEMI || jointype == JOIN_ANTI)
+        {
+            bool   isdefault;
+            double ninner = get_variable_numdistinct(join_is_reversed ? &vardata1 : &vardata2,
+                                                     &isdefault);
+
+            sel = 1.0 - exp(ninner * log1p(-Min(sel, 1.0 - 1e-10)));
+        }
+    }
+
+    ReleaseVariableStats(vardata1);
+    ReleaseVariableStats(vardata2);
+
+    CLAMP_PROBABILITY(sel);
+    PG_RETURN_FLOAT8(sel);
+}
@@ -0,0 +1,279 @@
+#include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+#include "fmgr.h"
+#include "funcapi.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+
+#include "dna.h"
+#include "dna_search.h"
+#include "kmer.h"
+#include "qkmer.h"
+
+#include <string.h>
+
+PG_FUNCTION_INFO_V1(dna_contains_kmer);
+PG_FUNCTION_INFO_V1(dna_contains_qkmer);
+PG_FUNCTION_INFO_V1(dna_contains_dna);
+PG_FUNCTION_INFO_V1(dna_position_dna);
+PG_FUNCTION_INFO_V1(dna_position_qkmer);
+PG_FUNCTION_INFO_V1(dna_find_all_dna);
+PG_FUNCTION_INFO_V1(dna_find_all_qkmer);
+PG_FUNCTION_INFO_V1(dna_lo_position_dna);
+PG_FUNCTION_INFO_V1(dna_lo_position_qkmer);
+PG_FUNCTION_INFO_V1(dna_lo_find_all_dna);
+PG_FUNCTION_INFO_V1(dna_lo_find_all_qkmer);
+
+
+typedef enum PatternKind
+{
+    PATTERN_DNA,
+    PATTERN_KMER,
+    PATTERN_QKMER
+} PatternKind;
+
+/*
+ * Compiled pattern of the last call, kept in fn_extra: the pattern is
+ * nearly always a constant, so the shift-or tables are built once per
+ * query instead of once per row.
+ */
+typedef struct PatternCache
+{
+    PatternKind kind;
+    Size        size;
+    char       *bytes;          // the pattern value it was compiled from
+    DnaPattern *pattern;
+} PatternCache;
+
+static DnaPattern *
+get_pattern(FunctionCallInfo fcinfo, int argno, PatternKind kind)
+{
+    PatternCache  *cache = (PatternCache *) fcinfo->flinfo->fn_extra;
+    Kmer           kmer = 0;
+    const void    *bytes;
+    Size           size;
+    MemoryContext  oldcxt;
+
+    if (kind == PATTERN_KMER)
+    {
+        kmer  = PG_GETARG_KMER(argno);
+        bytes = &kmer;
+        size  = sizeof(Kmer);
+    }
+    else
+    {
+        struct varlena *value = PG_DETOAST_DATUM(PG_GETARG_DATUM(argno));
+
+        if (kind == PATTERN_DNA)
+            check_dna_consistency((Dna *) value);
+        else
+            check_qkmer_consistency((QKmer *) value);
+        bytes = value;
+        size  = VARSIZE_ANY(value);
+    }
+
+    if (cache != NULL && cache->kind == kind && cache->size == size &&
+        memcmp(cache->bytes, bytes, size) == 0)
+        return cache->pattern;
+
+    oldcxt = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+
+    if (cache == NULL)
+        cache = (PatternCache *) palloc0(sizeof(PatternCache));
+    else
+    {
+        pfree(cache->bytes);
+        pfree(cache->pattern);
+    }
+
+    cache->kind  = kind;
+    cache->size  = size;
+    cache->bytes = palloc(size);
+    memcpy(cache->bytes, bytes, size);
+
+    switch (kind)
+    {
+        case PATTERN_DNA:
+            cache->pattern = dna_pattern_from_dna((const Dna *) cache->bytes);
+            break;
+        case PATTERN_KMER:
+            cache->pattern = dna_pattern_from_kmer(kmer);
+            break;
+        case PATTERN_QKMER:
+            cache->pattern = dna_pattern_from_qkmer((const QKmer *) cache->bytes);
+            break;
+    }
+    fcinfo->flinfo->fn_extra = cache;
+
+    MemoryContextSwitchTo(oldcxt);
+    return cache->pattern;
+}
+
+// the searched sequence is streamed, see dna_reader.h
+static DnaReader *
+get_text(FunctionCallInfo fcinfo)
+{
+    return dna_reader_open(PG_GETARG_DATUM(0));
+}
+
+
+// dna @> kmer: does the sequence contain the kmer?
+Datum
+dna_contains_kmer(PG_FUNCTION_ARGS)
+{
+    DnaReader  *dna     = get_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, PATTERN_KMER);
+
+    PG_RETURN_BOOL(dna_search_first(pattern, dna) >= 0);
+}
+
+// dna @> qkmer, dna_contains(dna, qkmer): does some window match the pattern?
+Datum
+dna_contains_qkmer(PG_FUNCTION_ARGS)
+{
+    DnaReader  *dna     = get_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, PATTERN_QKMER);
+
+    PG_RETURN_BOOL(dna_search_first(pattern, dna) >= 0);
+}
+
+// dna_contains(dna, dna): is the second sequence a substring of the first?
+Datum
+dna_contains_dna(PG_FUNCTION_ARGS)
+{
+    DnaReader  *dna     = get_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, PATTERN_DNA);
+
+    PG_RETURN_BOOL(dna_search_first(pattern, dna) >= 0);
+}
+
+/*
+ * dna_position(dna, pattern): 1-based start of the first match, 0 if none
+ * (as strpos).
+ */
+Datum
+dna_position_dna(PG_FUNCTION_ARGS)
+{
+    DnaReader  *dna     = get_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, PATTERN_DNA);
+
+    PG_RETURN_INT32((int32) (dna_search_first(pattern, dna) + 1));
+}
+
+Datum
+dna_position_qkmer(PG_FUNCTION_ARGS)
+{
+    DnaReader  *dna     = get_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, PATTERN_QKMER);
+
+    PG_RETURN_INT32((int32) (dna_search_first(pattern, dna) + 1));
+}
+
+/*
+ * dna_find_all(dna, pattern) -> SETOF integer
+ * 1-based starts of all matches, overlapping ones included, in order.
+ * Materialize mode: the matches go straight from the search callback to
+ * the tuplestore.
+ */
+typedef struct FindAllState
+{
+    ReturnSetInfo *rsinfo;
+    bool           wide;        // bigint positions (large objects)
+} FindAllState;
+
+static bool
+put_position(uint64 start, void *arg)
+{
+    FindAllState *state  = (FindAllState *) arg;
+    Datum         value;
+    bool          isnull = false;
+
+    if (state->wide)
+        value = Int64GetDatum((int64) (start + 1));
+    else
+        value = Int32GetDatum((int32) (start + 1));
+
+    tuplestore_putvalues(state->rsinfo->setResult, state->rsinfo->setDesc, &value, &isnull);
+    return true;
+}
+
+static Datum
+find_all(FunctionCallInfo fcinfo, DnaReader *(*open_text) (FunctionCallInfo),
+         PatternKind kind, bool wide)
+{
+    FindAllState   state;
+    DnaReader     *dna;
+    DnaPattern    *pattern;
+
+    InitMaterializedSRF(fcinfo, MAT_SRF_USE_EXPECTED_DESC);
+
+    state.rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    state.wide   = wide;
+
+    dna     = open_text(fcinfo);
+    pattern = get_pattern(fcinfo, 1, kind);
+    dna_search(pattern, dna, put_position, &state);
+    dna_reader_close(dna);
+
+    return (Datum) 0;
+}
+
+Datum
+dna_find_all_dna(PG_FUNCTION_ARGS)
+{
+    return find_all(fcinfo, get_text, PATTERN_DNA, false);
+}
+
+Datum
+dna_find_all_qkmer(PG_FUNCTION_ARGS)
+{
+    return find_all(fcinfo, get_text, PATTERN_QKMER, false);
+}
+
+
+/*
+ * The same searches on a dna large object (see dna_lo.c), streamed chunk
+ * by chunk; positions are bigint.
+ */
+static DnaReader *
+get_lo_text(FunctionCallInfo fcinfo)
+{
+    return dna_reader_open_lo(PG_GETARG_OID(0), CurrentMemoryContext);
+}
+
+static Datum
+lo_position(FunctionCallInfo fcinfo, PatternKind kind)
+{
+    DnaReader  *dna     = get_lo_text(fcinfo);
+    DnaPattern *pattern = get_pattern(fcinfo, 1, kind);
+    int64       first   = dna_search_first(pattern, dna);
+
+    dna_reader_close(dna);
+    PG_RETURN_INT64(first + 1);
+}
+
+Datum
+dna_lo_position_dna(PG_FUNCTION_ARGS)
+{
+    return lo_position(fcinfo, PATTERN_DNA);
+}
+
+Datum
+dna_lo_position_qkmer(PG_FUNCTION_ARGS)
+{
+    return lo_position(fcinfo, PATTERN_QKMER);
+}
+
+Datum
+dna_lo_find_all_dna(PG_FUNCTION_ARGS)
+{
+    return find_all(fcinfo, get_lo_text, PATTERN_DNA, true);
+}
+
+Datum
+dna_lo_find_all_qkmer(PG_FUNCTION_ARGS)
+{
+    return find_all(fcinfo, get_lo_text, PATTERN_QKMER, true);
+}
@@ -16,192 +16,187 @@ PG_FUNCTION_INFO_V1(kmer_starts_with);
 PG_FUNCTION_INFO_V1(qkmer_contains);
 PG_FUNCTION_INFO_V1(kmer_contained_by);
 PG_FUNCTION_INFO_V1(kmer_cmp);
+PG_FUNCTION_INFO_V1(kmer_ne);
+PG_FUNCTION_INFO_V1(kmer_lt);
+PG_FUNCTION_INFO_V1(kmer_le);
+PG_FUNCTION_INFO_V1(kmer_gt);
+PG_FUNCTION_INFO_V1(kmer_ge);
+PG_FUNCTION_INFO_V1(kmer_hamming);
+PG_FUNCTION_INFO_V1(kmer_within);
+PG_FUNCTION_INFO_V1(kmer_revcomp);
+PG_FUNCTION_INFO_V1(kmer_canonical);
+PG_FUNCTION_INFO_V1(kmer_canonical_eq);
 
 
+Datum
+kmer_eq(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
+
+    PG_RETURN_BOOL(kmer_eq_internal(a, b));
+}
 
 
-// qkmer helpers: length and consistency (same as qkmer.c logic)
-static inline int
-qkmer_length_internal(const QKmer *q)
+Datum
+kmer_starts_with(PG_FUNCTION_ARGS)
 {
-    Size size   = VARSIZE_ANY(q);
-    Size header = offsetof(QKmer, data);
+    Kmer value  = PG_GETARG_KMER(0);
+    Kmer prefix = PG_GETARG_KMER(1);
+
+    int np = kmer_length_internal(prefix);
+    int nv = kmer_length_internal(value);
 
-    if (size < header)
+    if (np > nv)
         ereport(ERROR,
-                (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("qkmer value is corrupted")));
+                (errcode(ERRCODE_DATA_EXCEPTION),
+                 errmsg("starts_with: prefix length %d exceeds kmer length %d",
+                        np, nv)));
 
-    return (int) (size - header);
+    PG_RETURN_BOOL(kmer_has_prefix_internal(value, prefix, np));
 }
 
-static inline void
-check_qkmer_consistency_ops(const QKmer *q)
+
+// qkmer @> kmer, word at a time; the lengths must agree
+static inline bool
+qkmer_contains_internal(const QKmer *pattern, Kmer value)
 {
-    int  n        = qkmer_length_internal(q);
-    Size expected = offsetof(QKmer, data) + n;
+    int np;
+    int nv;
 
-    if (n <= 0 || n > QKMER_MAX_LENGTH)
-        ereport(ERROR,
-                (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("qkmer value has unreasonable length: %d", n)));
+    check_qkmer_consistency(pattern);
 
-    if (VARSIZE_ANY(q) != expected)
+    np = qkmer_length_internal(pattern);
+    nv = kmer_length_internal(value);
+
+    if (np != nv)
         ereport(ERROR,
-                (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("qkmer value has invalid internal size")));
-}
+                (errcode(ERRCODE_DATA_EXCEPTION),
+                 errmsg("contains: pattern length %d does not match kmer length %d",
+                        np, nv)));
 
-// Does a single qkmer code match a concrete base A/C/G/T ? 
-static inline bool
-qbase_matches(char q, char base)
-{
-    switch (q)
-    {
-        case 'A': return base == 'A';
-        case 'C': return base == 'C';
-        case 'G': return base == 'G';
-        case 'T': return base == 'T';
-
-        case 'N': return (base == 'A' || base == 'C' || base == 'G' || base == 'T');
-        case 'R': return (base == 'A' || base == 'G');
-        case 'Y': return (base == 'C' || base == 'T');
-        case 'S': return (base == 'G' || base == 'C');
-        case 'W': return (base == 'A' || base == 'T');
-        case 'K': return (base == 'G' || base == 'T');
-        case 'M': return (base == 'A' || base == 'C');
-        case 'B': return (base == 'C' || base == 'G' || base == 'T');      // not A 
-        case 'D': return (base == 'A' || base == 'G' || base == 'T');      // not C 
-        case 'H': return (base == 'A' || base == 'C' || base == 'T');      // not G 
-        case 'V': return (base == 'A' || base == 'C' || base == 'G');      // not T 
-
-        default:
-            ereport(ERROR,
-                    (errcode(ERRCODE_DATA_CORRUPTED),
-                     errmsg("qkmer contains invalid IUPAC code '%c'", q)));
-            return false;
-    }
+    return qkmer_matches_range(pattern, value, 0, np);
 }
 
 
 Datum
-kmer_eq(PG_FUNCTION_ARGS)
+qkmer_contains(PG_FUNCTION_ARGS)
 {
-    Kmer *a = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    Kmer *b = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    QKmer *pattern = (QKmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
 
-    int na = a->length;
-    int nb = b->length;
+    PG_RETURN_BOOL(qkmer_contains_internal(pattern, PG_GETARG_KMER(1)));
+}
 
-    if (na != nb)
-        PG_RETURN_BOOL(false);
 
-    for (int i = 0; i < na; i++)
-    {
-        char ca = kmer_get_base(a, i);
-        char cb = kmer_get_base(b, i);
-        if (ca != cb)
-            PG_RETURN_BOOL(false);
-    }
+// kmer <@ qkmer: the commutator, arguments swapped
+Datum
+kmer_contained_by(PG_FUNCTION_ARGS)
+{
+    QKmer *pattern = (QKmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
 
-    PG_RETURN_BOOL(true);
+    PG_RETURN_BOOL(qkmer_contains_internal(pattern, PG_GETARG_KMER(0)));
 }
 
-
 Datum
-kmer_starts_with(PG_FUNCTION_ARGS)
+kmer_cmp(PG_FUNCTION_ARGS)
 {
-    Kmer *value = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    Kmer *prefix  = (Kmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    int np = prefix->length;
-    int nv = value->length;
+    PG_RETURN_INT32(kmer_cmp_internal(a, b));
+}
 
-    if (np > nv)
-        ereport(ERROR,
-                (errcode(ERRCODE_DATA_EXCEPTION),
-                 errmsg("starts_with: prefix length %d exceeds kmer length %d",
-                        np, nv)));
 
-    for (int i = 0; i < np; i++)
-    {
-        char cp = kmer_get_base(prefix, i);
-        char cv = kmer_get_base(value, i);
-        if (cp != cv)
-            PG_RETURN_BOOL(false);
-    }
+// comparison operators: direct C entry points for <>, <, <=, >, >=
+
+Datum
+kmer_ne(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    PG_RETURN_BOOL(true);
+    PG_RETURN_BOOL(!kmer_eq_internal(a, b));
 }
 
+Datum
+kmer_lt(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
+
+    PG_RETURN_BOOL(kmer_cmp_internal(a, b) < 0);
+}
 
 Datum
-qkmer_contains(PG_FUNCTION_ARGS)
+kmer_le(PG_FUNCTION_ARGS)
 {
-    QKmer *pattern = (QKmer *) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    Kmer  *value   = (Kmer  *) PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int    np;
-    int    nv;
-    check_qkmer_consistency_ops(pattern);
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    np = qkmer_length_internal(pattern);
-    nv = value->length;
+    PG_RETURN_BOOL(kmer_cmp_internal(a, b) <= 0);
+}
 
-    if (np != nv)
-        ereport(ERROR,
-                (errcode(ERRCODE_DATA_EXCEPTION),
-                 errmsg("contains: pattern length %d does not match kmer length %d",
-                        np, nv)));
+Datum
+kmer_gt(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    for (int i = 0; i < np; i++)
-    {
-        char q = pattern->data[i];        //already uppercase IUPAC
-        char b = kmer_get_base(value, i); // A/C/G/T 
+    PG_RETURN_BOOL(kmer_cmp_internal(a, b) > 0);
+}
 
-        if (!qbase_matches(q, b))
-            PG_RETURN_BOOL(false);
-    }
+Datum
+kmer_ge(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    PG_RETURN_BOOL(true);
+    PG_RETURN_BOOL(kmer_cmp_internal(a, b) >= 0);
 }
 
 
+// Hamming distance: the <-> operator
+
 Datum
-kmer_contained_by(PG_FUNCTION_ARGS)
+kmer_hamming(PG_FUNCTION_ARGS)
 {
-    // Arguments: arg0=kmer, arg1=qkmer
-    // qkmer_contains expects: arg0=qkmer, arg1=kmer
-    // So swap them!
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    Datum kmer_arg  = PG_GETARG_DATUM(0);
-    Datum qkmer_arg = PG_GETARG_DATUM(1);
-
-    return DirectFunctionCall2(qkmer_contains, qkmer_arg, kmer_arg);
+    PG_RETURN_INT32(kmer_hamming_internal(a, b));
 }
 
+// kmer_within(a, b, d): at most d mismatches between a and b
 Datum
-kmer_cmp(PG_FUNCTION_ARGS)
+kmer_within(PG_FUNCTION_ARGS)
 {
-    Kmer *a = (Kmer*) PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    Kmer *b = (Kmer*) PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    Kmer  a = PG_GETARG_KMER(0);
+    Kmer  b = PG_GETARG_KMER(1);
+    int32 d = PG_GETARG_INT32(2);
 
-    int na = a->length;
-    int nb = b->length;
+    PG_RETURN_BOOL(kmer_hamming_internal(a, b) <= d);
+}
 
-    int min = (na < nb ? na : nb);
+// Reverse complement and canonical form (see kmer.h)
 
-    for (int i = 0; i < min; i++)
-    {
-        char ba = kmer_get_base(a, i);
-        char bb = kmer_get_base(b, i);
+Datum
+kmer_revcomp(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_KMER(kmer_revcomp_internal(PG_GETARG_KMER(0)));
+}
 
-        if (ba < bb) PG_RETURN_INT32(-1);
-        if (ba > bb) PG_RETURN_INT32(1);
-    }
+Datum
+kmer_canonical(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_KMER(kmer_canonical_internal(PG_GETARG_KMER(0)));
+}
 
-    // If all equal so far, shorter one is smaller
-    if (na < nb) PG_RETURN_INT32(-1);
-    if (na > nb) PG_RETURN_INT32(1);
+// a ~= b: same kmer on either strand (a = b or a = revcomp(b))
+Datum
+kmer_canonical_eq(PG_FUNCTION_ARGS)
+{
+    Kmer a = PG_GETARG_KMER(0);
+    Kmer b = PG_GETARG_KMER(1);
 
-    PG_RETURN_INT32(0);
+    PG_RETURN_BOOL(kmer_canonical_internal(a) == kmer_canonical_internal(b));
 }
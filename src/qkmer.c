@@ -3,6 +3,7 @@
 #include "varatt.h"
 #endif
 #include "fmgr.h"
+#include "libpq/pqformat.h"
 #include "utils/varlena.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
@@ -14,83 +15,63 @@
 /*
  * qkmer: query k-mer with ambiguity codes (IUPAC)
  *
- * Stored as a varlena struct:
+ * Stored as one 4-bit base set per position, two per byte (see qkmer.h).
  *
- *   struct QKmer {
- *       int32 vl_len_;
- *       char  data[FLEXIBLE_ARRAY_MEMBER];   -- n characters, no '\0'
- *   }
- *
- * Allowed characters (case-insensitive on input, stored as uppercase):
+ * Allowed characters (case-insensitive on input, output as uppercase):
  *   A C G T
  *   N R Y S W K M B D H V
  */
 
+// IUPAC code of each base set (A=1, C=2, G=4, T=8); set 0 is invalid
+static const char qkmer_set_to_code[16] = "-ACMGRSVTWYHKDBN";
 
-// Normalize and validate a qkmer base; return uppercase IUPAC char 
-static inline char
-normalize_qbase(char c)
+// Base set of an IUPAC character, any case
+static inline int
+qbase_to_set(char c)
 {
-    char u = (char)toupper((unsigned char)c);
-
-    switch (u)
+    switch (toupper((unsigned char) c))
     {
-    case 'A':
-    case 'C':
-    case 'G':
-    case 'T':
-    case 'N':
-    case 'R':
-    case 'Y':
-    case 'S':
-    case 'W':
-    case 'K':
-    case 'M':
-    case 'B':
-    case 'D':
-    case 'H':
-    case 'V':
-        return u;
+    case 'A': return QKMER_SET_A;
+    case 'C': return QKMER_SET_C;
+    case 'G': return QKMER_SET_G;
+    case 'T': return QKMER_SET_T;
+    case 'M': return QKMER_SET_A | QKMER_SET_C;
+    case 'R': return QKMER_SET_A | QKMER_SET_G;
+    case 'W': return QKMER_SET_A | QKMER_SET_T;
+    case 'S': return QKMER_SET_C | QKMER_SET_G;
+    case 'Y': return QKMER_SET_C | QKMER_SET_T;
+    case 'K': return QKMER_SET_G | QKMER_SET_T;
+    case 'V': return QKMER_SET_N & ~QKMER_SET_T;
+    case 'H': return QKMER_SET_N & ~QKMER_SET_G;
+    case 'D': return QKMER_SET_N & ~QKMER_SET_C;
+    case 'B': return QKMER_SET_N & ~QKMER_SET_A;
+    case 'N': return QKMER_SET_N;
 
     default:
         ereport(ERROR,
                 (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
                  errmsg("invalid qkmer base: '%c' (allowed: A,C,G,T,N,R,Y,S,W,K,M,B,D,H,V)", c)));
-        return 'A';
+        return 0;
     }
 }
 
-// Compute the number of characters stored in this qkmer 
-static inline int
-qkmer_length_internal(const QKmer *q)
+// Sanity checks: length and size consistency
+void
+check_qkmer_consistency(const QKmer *q)
 {
     Size size = VARSIZE_ANY(q);
-    Size header = offsetof(QKmer, data);
 
-    if (size < header)
+    if (size < offsetof(QKmer, data))
         ereport(ERROR,
                 (errcode(ERRCODE_DATA_CORRUPTED),
                  errmsg("qkmer value is corrupted")));
 
-    return (int)(size - header);
-}
-
-// Sanity checks: length and size consistency 
-static void
-check_qkmer_consistency(const QKmer *q)
-{
-    int n;
-    Size expected;
-
-    n = qkmer_length_internal(q);
-
-    if (n < 0 || n > QKMER_MAX_LENGTH)
+    if (q->length == 0 || q->length > QKMER_MAX_LENGTH)
         ereport(ERROR,
                 (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("qkmer value has unreasonable length")));
+                 errmsg("qkmer value has unreasonable length: %d", q->length)));
 
-    expected = offsetof(QKmer, data) + n;
-    if (VARSIZE_ANY(q) != expected)
+    if (size != QKMER_SIZE(q->length))
         ereport(ERROR,
                 (errcode(ERRCODE_DATA_CORRUPTED),
                  errmsg("qkmer value has invalid internal size")));
@@ -121,18 +102,14 @@ Datum qkmer_in(PG_FUNCTION_ARGS)
                 (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
                  errmsg("qkmer length %d exceeds maximum %d", n, QKMER_MAX_LENGTH)));
 
-    size = offsetof(QKmer, data) + n;
-
-    if (size > MaxAllocSize)
-        ereport(ERROR,
-                (errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
-                 errmsg("qkmer is too large")));
+    size = QKMER_SIZE(n);
 
-    q = (QKmer *)palloc(size);
+    q = (QKmer *)palloc0(size);
     SET_VARSIZE(q, size);
+    q->length = (uint8) n;
 
     for (int i = 0; i < n; i++)
-        q->data[i] = normalize_qbase(input[i]);
+        q->data[i / 2] |= (uint8) (qbase_to_set(input[i]) << ((i % 2 == 0) ? 4 : 0));
 
     PG_RETURN_POINTER(q);
 }
@@ -155,7 +132,8 @@ Datum qkmer_out(PG_FUNCTION_ARGS)
     n = qkmer_length_internal(q);
 
     res = (char *)palloc(n + 1);
-    memcpy(res, q->data, n);
+    for (int i = 0; i < n; i++)
+        res[i] = qkmer_set_to_code[qkmer_get_set(q, i)];
     res[n] = '\0';
 
     PG_RETURN_CSTRING(res);
@@ -177,3 +155,82 @@ Datum qkmer_length(PG_FUNCTION_ARGS)
 
     PG_RETURN_INT32(n);
 }
+
+
+/*
+ * Binary I/O: one byte with the length, then the 4-bit base sets packed
+ * two per byte (first code in the high nibble, odd tail padded with 0),
+ * i.e. the stored form without the varlena header.
+ */
+PG_FUNCTION_INFO_V1(qkmer_recv);
+
+Datum qkmer_recv(PG_FUNCTION_ARGS)
+{
+    StringInfo buf;
+    int n;
+    int nbytes;
+    const unsigned char *packed;
+    Size size;
+    QKmer *q;
+
+    buf = (StringInfo) PG_GETARG_POINTER(0);
+    n = pq_getmsgbyte(buf);
+
+    if (n == 0 || n > QKMER_MAX_LENGTH)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("invalid qkmer length %d in binary data (allowed: 1..%d)",
+                        n, QKMER_MAX_LENGTH)));
+
+    nbytes = QKMER_DATA_BYTES(n);
+    if (buf->len - buf->cursor != nbytes)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("invalid qkmer binary data: expected %d bytes for %d codes, got %d",
+                        nbytes, n, buf->len - buf->cursor)));
+
+    packed = (const unsigned char *) pq_getmsgbytes(buf, nbytes);
+
+    size = QKMER_SIZE(n);
+    q = (QKmer *)palloc(size);
+    SET_VARSIZE(q, size);
+    q->length = (uint8) n;
+    memcpy(q->data, packed, nbytes);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (qkmer_get_set(q, i) == 0)
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                     errmsg("invalid qkmer binary data: empty base set at position %d", i + 1)));
+    }
+
+    if (n % 2 != 0 && (packed[nbytes - 1] & 0x0F) != 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+                 errmsg("invalid qkmer binary data: padding bits are not zero")));
+
+    PG_RETURN_POINTER(q);
+}
+
+
+PG_FUNCTION_INFO_V1(qkmer_send);
+
+Datum qkmer_send(PG_FUNCTION_ARGS)
+{
+    QKmer *q;
+    int n;
+    StringInfoData buf;
+
+    q = (QKmer *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+
+    check_qkmer_consistency(q);
+
+    n = qkmer_length_internal(q);
+
+    pq_begintypsend(&buf);
+    pq_sendbyte(&buf, (uint8) n);
+    pq_sendbytes(&buf, (const char *) q->data, QKMER_DATA_BYTES(n));
+
+    PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
@@ -2,13 +2,153 @@
 #define QKMER_H
 
 #include "postgres.h"
+#if PG_VERSION_NUM >= 160000
+#include "varatt.h"
+#endif
+
+#include "kmer.h"
 
 #define QKMER_MAX_LENGTH 32
 
+/*
+ * qkmer is a varlena holding one 4-bit base set per position (A=1, C=2,
+ * G=4, T=8, so bit c is the 2-bit kmer code c and N is 0xF), two per byte
+ * with the first position in the high nibble. An odd tail is padded with
+ * a zero nibble; the empty set is never stored. This is also the binary
+ * wire format.
+ */
 typedef struct QKmer
 {
     int32 vl_len_;
-    char data[FLEXIBLE_ARRAY_MEMBER]; // stored as uppercase IUPAC chars 
+    uint8 length;                        // positions, 1..QKMER_MAX_LENGTH
+    uint8 data[FLEXIBLE_ARRAY_MEMBER];   // (length + 1) / 2 bytes of base sets
 } QKmer;
 
-#endif 
+#define QKMER_SET_A 0x1
+#define QKMER_SET_C 0x2
+#define QKMER_SET_G 0x4
+#define QKMER_SET_T 0x8
+#define QKMER_SET_N 0xF
+
+#define QKMER_DATA_BYTES(n)  (((n) + 1) / 2)
+#define QKMER_SIZE(n)        (offsetof(QKmer, data) + QKMER_DATA_BYTES(n))
+
+// lowest bit of every nibble
+#define QKMER_NIBBLE_LSB     UINT64CONST(0x1111111111111111)
+
+extern void check_qkmer_consistency(const QKmer *q);
+
+static inline int
+qkmer_length_internal(const QKmer *q)
+{
+    return q->length;
+}
+
+// base set (1..15) of position i
+static inline int
+qkmer_get_set(const QKmer *q, int i)
+{
+    return (q->data[i >> 1] >> ((i & 1) ? 0 : 4)) & 0x0F;
+}
+
+// 2-bit code of position i when it is a single base, otherwise -1
+static inline int
+qkmer_get_code(const QKmer *q, int i)
+{
+    static const int8 set_code[16] = {
+        -1, 0, 1, -1, 2, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1, -1
+    };
+
+    return set_code[qkmer_get_set(q, i)];
+}
+
+/*
+ * Word-at-a-time matching against a kmer. Both sides are laid out as 16
+ * nibbles per word, position 0 in the top nibble: the qkmer sets as
+ * stored, the kmer as one-hot nibbles (1 << code). A position matches
+ * when its nibble of (sets & onehot) is non-zero.
+ */
+
+// base sets of positions 16w .. 16w+15, missing positions are 0
+static inline uint64
+qkmer_set_word(const QKmer *q, int w)
+{
+    int    nbytes = QKMER_DATA_BYTES(q->length) - 8 * w;
+    uint64 word = 0;
+
+    if (nbytes >= 8)
+    {
+        memcpy(&word, q->data + 8 * w, sizeof(word));
+        return pg_ntoh64(word);
+    }
+    for (int j = 0; j < nbytes; j++)
+        word |= (uint64) q->data[8 * w + j] << (56 - 8 * j);
+    return word;
+}
+
+// 16 2-bit codes (first in bits 31..30) to 16 one-hot nibbles
+static inline uint64
+kmer_onehot_word(uint32 codes)
+{
+    uint64 x = codes;
+    uint64 lo;
+    uint64 hi;
+    uint64 v;
+
+    // spread each 2-bit code to the bottom of its own nibble
+    x = (x | (x << 16)) & UINT64CONST(0x0000FFFF0000FFFF);
+    x = (x | (x << 8))  & UINT64CONST(0x00FF00FF00FF00FF);
+    x = (x | (x << 4))  & UINT64CONST(0x0F0F0F0F0F0F0F0F);
+    x = (x | (x << 2))  & UINT64CONST(0x3333333333333333);
+
+    lo = x & QKMER_NIBBLE_LSB;
+    hi = (x >> 1) & QKMER_NIBBLE_LSB;
+
+    // 1 << lo in each nibble, then shifted up by 2 where hi is set
+    v = QKMER_NIBBLE_LSB + lo;
+    hi *= 0xF;
+    return (v & ~hi) | ((v & hi) << 2);
+}
+
+// nibble LSBs of the first n positions of a word (0 <= n <= 16)
+static inline uint64
+qkmer_nibble_prefix(int n)
+{
+    return n <= 0 ? 0 : QKMER_NIBBLE_LSB & (~UINT64CONST(0) << (64 - 4 * n));
+}
+
+// do positions from .. to-1 of q accept the bases of k? (to <= kmer length)
+static inline bool
+qkmer_matches_range(const QKmer *q, Kmer k, int from, int to)
+{
+    uint64 diff = 0;
+
+    for (int w = 0; w < 2; w++)
+    {
+        int    first = Max(from - 16 * w, 0);
+        int    last = Min(to - 16 * w, 16);
+        uint64 want;
+        uint64 hit;
+
+        if (last <= first)
+            continue;
+        want = qkmer_nibble_prefix(last) & ~qkmer_nibble_prefix(first);
+
+        hit = qkmer_set_word(q, w) & kmer_onehot_word((uint32) (k >> (32 - 32 * w)));
+        hit |= hit >> 1;
+        hit |= hit >> 2;
+        diff |= (hit & want) ^ want;
+    }
+    return diff == 0;
+}
+
+// qkmer @> kmer: same length and every position accepts its base
+static inline bool
+qkmer_matches_kmer(const QKmer *q, Kmer k)
+{
+    int n = qkmer_length_internal(q);
+
+    return n == kmer_length_internal(k) && qkmer_matches_range(q, k, 0, n);
+}
+
+#endif
@@ -8,11 +8,15 @@
 #include "utils/builtins.h"
 #include "catalog/pg_type.h"
 #include "utils/varlena.h"
-#include "access/spgist.h"
+#include "funcapi.h"
+#include "utils/guc.h"
 #include "kmer.h"
 #include "qkmer.h"
+#include "spgist_kmer.h"
 
+#define KMER_CANONICAL_EQUAL_STRATEGY 6     // ~=, as RTSameStrategyNumber
 #define KMER_QKMER_CONTAINS_STRATEGY 10
+#define KMER_HAMMING_DISTANCE_STRATEGY 15
 #define KMER_PREFIX_CONTAINS_STRATEGY 28
 //implementation of the generic spgist functions
 
@@ -21,54 +25,201 @@ PG_FUNCTION_INFO_V1(spg_kmer_choose);
 PG_FUNCTION_INFO_V1(spg_kmer_picksplit);
 PG_FUNCTION_INFO_V1(spg_kmer_inner_consistent);
 PG_FUNCTION_INFO_V1(spg_kmer_leaf_consistent);
+PG_FUNCTION_INFO_V1(pg_dna_scan_stats);
+
+bool          kmer_track_scan_stats = false;
+KmerScanStats kmer_scan_stats;
+
 
+// called from _PG_init
+void
+spg_kmer_init(void)
+{
+    DefineCustomBoolVariable("pg_dna.track_scan_stats",
+                             "Collect SP-GiST kmer scan counters for pg_dna_scan_stats().",
+                             NULL,
+                             &kmer_track_scan_stats,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL, NULL, NULL);
+
+    MarkGUCPrefixReserved("pg_dna");
+}
 
+// pg_dna_scan_stats(reset) -> counters collected since the last reset
 Datum
-spg_kmer_config(PG_FUNCTION_ARGS)
+pg_dna_scan_stats(PG_FUNCTION_ARGS)
 {
-    spgConfigIn  *cfgin = (spgConfigIn *) PG_GETARG_POINTER(0);
-    spgConfigOut *cfg   = (spgConfigOut *) PG_GETARG_POINTER(1);
+    bool      reset = PG_GETARG_BOOL(0);
+    TupleDesc tupdesc;
+    Datum     values[5];
+    bool      nulls[5] = {false, false, false, false, false};
 
-    /* suppress unused warning; nothing needed from cfgin currently */
-    (void) cfgin;
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("function returning record called in context "
+                        "that cannot accept type record")));
+    tupdesc = BlessTupleDesc(tupdesc);
 
-    cfg->prefixType = VOIDOID;//empty
-    cfg->labelType = VOIDOID; // detrminist so we don't need labels see helper function bellow
+    values[0] = Int64GetDatum(kmer_scan_stats.inner_visited);
+    values[1] = Int64GetDatum(kmer_scan_stats.nodes_descended);
+    values[2] = Int64GetDatum(kmer_scan_stats.nodes_pruned);
+    values[3] = Int64GetDatum(kmer_scan_stats.leaves_tested);
+    values[4] = Int64GetDatum(kmer_scan_stats.leaves_matched);
 
-     // InvalidOid means “same as column type”.
-    cfg->leafType = InvalidOid;
+    if (reset)
+        memset(&kmer_scan_stats, 0, sizeof(kmer_scan_stats));
 
-    cfg->canReturnData = true;
-    cfg->longValuesOK  = false;
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
 
-    PG_RETURN_VOID();
+// account for one inner tuple visit (only when tracking is enabled)
+static inline void
+count_inner_visit(const spgInnerConsistentIn *in, const spgInnerConsistentOut *out)
+{
+    if (!kmer_track_scan_stats)
+        return;
+
+    kmer_scan_stats.inner_visited++;
+    kmer_scan_stats.nodes_descended += out->nNodes;
+    kmer_scan_stats.nodes_pruned    += in->nNodes - out->nNodes;
+}
+
+static inline void
+count_leaf_test(bool matched)
+{
+    if (!kmer_track_scan_stats)
+        return;
+
+    kmer_scan_stats.leaves_tested++;
+    if (matched)
+        kmer_scan_stats.leaves_matched++;
+}
+
+
+/*
+ * Radix tree over the bases, with path compression as in spg_text_ops:
+ *
+ *  - an inner tuple may carry a prefix, the bases shared by everything
+ *    below it;
+ *  - its nodes are labelled with the next base code (0..3), KMER_NODE_END
+ *    for values that end right after the prefix, or KMER_NODE_DUMMY for the
+ *    lower half of a split allTheSame tuple (see spg_kmer_choose);
+ *  - leaves only keep the bases that are not already spelled out by the
+ *    path, and the full kmer is rebuilt from reconstructedValue.
+ *
+ * Prefixes, leaves and reconstructed values are all "fragments": the kmer
+ * word layout, except that a fragment may hold 0 bases (terminator at bit
+ * 63). in->level is always the number of bases on the path so far.
+ */
+#define KMER_NODE_END    (-1)
+#define KMER_NODE_DUMMY  (-2)
+
+#define KMER_EMPTY_FRAGMENT KMER_TERMINATOR(0)
+
+// bases of a fragment, terminator cleared
+static inline uint64
+frag_bases(Kmer f)
+{
+    return f & (f - 1);
+}
+
+// first n bases of f
+static inline Kmer
+frag_head(Kmer f, int n)
+{
+    if (n == 0)
+        return KMER_EMPTY_FRAGMENT;
+    return (f & kmer_prefix_mask(n)) | KMER_TERMINATOR(n);
+}
+
+// f without its first n bases
+static inline Kmer
+frag_tail(Kmer f, int n)
+{
+    return (frag_bases(f) << (2 * n)) | KMER_TERMINATOR(kmer_length_internal(f) - n);
 }
 
+// a followed by b (the sum of the lengths never exceeds KMER_MAX_LENGTH)
+static inline Kmer
+frag_concat(Kmer a, Kmer b)
+{
+    int la = kmer_length_internal(a);
+
+    return frag_bases(a) | (frag_bases(b) >> (2 * la)) |
+        KMER_TERMINATOR(la + kmer_length_internal(b));
+}
 
-//helper function to guide a the child explorations that is what makes the use of labels unnecessary
+// a followed by one base
+static inline Kmer
+frag_append(Kmer a, int code)
+{
+    int la = kmer_length_internal(a);
 
+    return frag_bases(a) | ((uint64) code << KMER_BASE_SHIFT(la)) | KMER_TERMINATOR(la + 1);
+}
+
+// number of leading bases a and b have in common
 static inline int
-kmer_node_for_level(const Kmer *k, int level)
+frag_common_length(Kmer a, Kmer b)
 {
-    char c;
+    uint64 diff = frag_bases(a) ^ frag_bases(b);
+    int    n    = Min(kmer_length_internal(a), kmer_length_internal(b));
+
+    if (diff != 0)
+        n = Min(n, (63 - pg_leftmost_one_pos64(diff)) >> 1);
+    return n;
+}
 
-    if (level >= k->length)
-        return 4;  // end
+// bases spelled out by the path above an inner or leaf tuple
+static inline Kmer
+reconstructed_path(int level, Datum reconstructed)
+{
+    // the root gets no reconstructed value
+    if (level == 0)
+        return KMER_EMPTY_FRAGMENT;
+    return DatumGetKmer(reconstructed);
+}
 
-    c = kmer_get_base(k, level);
-    // based on this char we now wich child to explore
-    switch (c)
+/*
+ * Find a node label; on failure *i is where it would have to be inserted
+ * to keep the labels sorted. At most 6 labels, so a linear scan.
+ */
+static bool
+search_node_label(const Datum *labels, int nNodes, int16 label, int *i)
+{
+    for (*i = 0; *i < nNodes; (*i)++)
     {
-    case 'A': return 0;
-    case 'C': return 1;
-    case 'G': return 2;
-    case 'T': return 3;
-    default:
-        ereport(ERROR,
-                (errcode(ERRCODE_DATA_EXCEPTION),
-                  errmsg("invalid base '%c' in kmer", c)));
-        return 0;
+        int16 cur = DatumGetInt16(labels[*i]);
+
+        if (cur == label)
+            return true;
+        if (cur > label)
+            break;
     }
+    return false;
+}
+
+
+Datum
+spg_kmer_config(PG_FUNCTION_ARGS)
+{
+    spgConfigIn  *cfgin = (spgConfigIn *) PG_GETARG_POINTER(0);
+    spgConfigOut *cfg   = (spgConfigOut *) PG_GETARG_POINTER(1);
+
+    // prefixes are fragments, which share the kmer word layout
+    cfg->prefixType = cfgin->attType;
+    cfg->labelType  = INT2OID;
+
+     // InvalidOid means “same as column type”: leaves hold suffix fragments
+    cfg->leafType = InvalidOid;
+
+    cfg->canReturnData = true;
+    cfg->longValuesOK  = false;
+
+    PG_RETURN_VOID();
 }
 
 
@@ -78,21 +229,78 @@ spg_kmer_choose(PG_FUNCTION_ARGS)
     spgChooseIn  *in  = (spgChooseIn *) PG_GETARG_POINTER(0);
     spgChooseOut *out = (spgChooseOut *) PG_GETARG_POINTER(1);
 
-    // extract the kmer value
-    Kmer *k = (Kmer *) PG_DETOAST_DATUM(in->datum);
+    // in->datum is the full kmer; the path above us spelled out in->level bases
+    Kmer  rest      = frag_tail(DatumGetKmer(in->datum), in->level);
+    int   restLen   = kmer_length_internal(rest);
+    int   commonLen = 0;
+    int16 label;
+    int   i;
 
-    int nodeN = kmer_node_for_level(k, in->level); //determine which child to visit
+    if (in->hasPrefix)
+    {
+        Kmer prefix    = DatumGetKmer(in->prefixDatum);
+        int  prefixLen = kmer_length_internal(prefix);
+
+        commonLen = frag_common_length(rest, prefix);
 
+        if (commonLen < prefixLen)
+        {
+            // the new value leaves the prefix: split it at the first difference
+            out->resultType = spgSplitTuple;
+
+            out->result.splitTuple.prefixHasPrefix   = commonLen > 0;
+            out->result.splitTuple.prefixPrefixDatum = KmerGetDatum(frag_head(prefix, commonLen));
+
+            out->result.splitTuple.prefixNNodes      = 1;
+            out->result.splitTuple.prefixNodeLabels  = (Datum *) palloc(sizeof(Datum));
+            out->result.splitTuple.prefixNodeLabels[0] =
+                Int16GetDatum(kmer_get_code(prefix, commonLen));
+            out->result.splitTuple.childNodeN        = 0;
+
+            out->result.splitTuple.postfixHasPrefix   = prefixLen - commonLen > 1;
+            out->result.splitTuple.postfixPrefixDatum =
+                KmerGetDatum(frag_tail(prefix, commonLen + 1));
+
+            PG_RETURN_VOID();
+        }
+    }
 
-    if (in->nNodes > 0 && nodeN >= in->nNodes) // avoid accessing an index that dosen't exist
-        nodeN = in->nNodes - 1;
+    label = (restLen > commonLen) ? kmer_get_code(rest, commonLen) : KMER_NODE_END;
 
-    // We match an existing node
-    out->resultType = spgMatchNode;
+    if (search_node_label(in->nodeLabels, in->nNodes, label, &i))
+    {
+        int levelAdd = commonLen + (label >= 0 ? 1 : 0);
 
-    out->result.matchNode.nodeN     = nodeN;
-    out->result.matchNode.levelAdd  = 1;
-    out->result.matchNode.restDatum = in->datum;
+        out->resultType = spgMatchNode;
+        out->result.matchNode.nodeN     = i;
+        out->result.matchNode.levelAdd  = levelAdd;
+        out->result.matchNode.restDatum = KmerGetDatum(frag_tail(rest, levelAdd));
+    }
+    else if (in->allTheSame)
+    {
+        /*
+         * Nodes can't be added to an allTheSame tuple. Push it down under a
+         * new tuple with the same prefix and a single dummy node; the next
+         * call adds the node we need next to it.
+         */
+        out->resultType = spgSplitTuple;
+
+        out->result.splitTuple.prefixHasPrefix   = in->hasPrefix;
+        out->result.splitTuple.prefixPrefixDatum = in->prefixDatum;
+
+        out->result.splitTuple.prefixNNodes      = 1;
+        out->result.splitTuple.prefixNodeLabels  = (Datum *) palloc(sizeof(Datum));
+        out->result.splitTuple.prefixNodeLabels[0] = Int16GetDatum(KMER_NODE_DUMMY);
+        out->result.splitTuple.childNodeN        = 0;
+
+        out->result.splitTuple.postfixHasPrefix  = false;
+    }
+    else
+    {
+        out->resultType = spgAddNode;
+        out->result.addNode.nodeLabel = Int16GetDatum(label);
+        out->result.addNode.nodeN     = i;
+    }
 
     PG_RETURN_VOID();
 }
@@ -104,298 +312,285 @@ spg_kmer_picksplit(PG_FUNCTION_ARGS)
     spgPickSplitIn  *in  = (spgPickSplitIn *) PG_GETARG_POINTER(0);
     spgPickSplitOut *out = (spgPickSplitOut *) PG_GETARG_POINTER(1);
 
-    int i;
+    Kmer  first = DatumGetKmer(in->datums[0]);
+    int   commonLen;
+    int   nodeOf[6];           // label + 2 -> node number, -1 if unused
+    int16 labels[6];
+    int   i;
 
-    //we don't store prefixe since each level corrspond to the base at position level
-    out->hasPrefix   = false;
-    out->prefixDatum = (Datum) 0;
+    // the prefix is everything the tuples agree on
+    commonLen = kmer_length_internal(first);
+    for (i = 1; i < in->nTuples && commonLen > 0; i++)
+        commonLen = Min(commonLen, frag_common_length(first, DatumGetKmer(in->datums[i])));
 
-     //fixe pattern no need for a label
-    out->nNodes     = 5;
-    out->nodeLabels = NULL;
+    out->hasPrefix   = commonLen > 0;
+    out->prefixDatum = KmerGetDatum(frag_head(first, commonLen));
 
-    //allocate output tables
-    out->mapTuplesToNodes =
-        (int *) palloc(sizeof(int) * in->nTuples);
-    out->leafTupleDatums  =
-        (Datum *) palloc(sizeof(Datum) * in->nTuples);
+    out->mapTuplesToNodes = (int *) palloc(sizeof(int) * in->nTuples);
+    out->leafTupleDatums  = (Datum *) palloc(sizeof(Datum) * in->nTuples);
 
+    // label of each tuple: the base right after the prefix, or END
     for (i = 0; i < in->nTuples; i++)
     {
-        Kmer *k = (Kmer *) PG_DETOAST_DATUM(in->datums[i]);
-        int   nodeN = kmer_node_for_level(k, in->level);
-
-        // should never happend but just in case
-        if (nodeN < 0 || nodeN >= out->nNodes)
-            ereport(ERROR,
-                    (errcode(ERRCODE_DATA_EXCEPTION),
-                     errmsg("spgist kmer picksplit: invalid node index %d", nodeN)));
-
-        // tells in which child this tuple gies
-        out->mapTuplesToNodes[i] = nodeN;
-        // kmer stored as a leaf
-        out->leafTupleDatums[i]  = in->datums[i];
+        Kmer  f = DatumGetKmer(in->datums[i]);
+        int16 label = (kmer_length_internal(f) > commonLen) ?
+            kmer_get_code(f, commonLen) : KMER_NODE_END;
+
+        out->mapTuplesToNodes[i] = label;
+        out->leafTupleDatums[i]  =
+            KmerGetDatum(frag_tail(f, commonLen + (label >= 0 ? 1 : 0)));
     }
 
-    PG_RETURN_VOID();
-}
+    // one node per label in use, in label order
+    for (i = 0; i < 6; i++)
+        nodeOf[i] = -1;
+    for (i = 0; i < in->nTuples; i++)
+        nodeOf[out->mapTuplesToNodes[i] + 2] = 0;
 
+    out->nNodes = 0;
+    for (i = 0; i < 6; i++)
+    {
+        if (nodeOf[i] < 0)
+            continue;
+        nodeOf[i] = out->nNodes;
+        labels[out->nNodes++] = (int16) (i - 2);
+    }
 
-static inline int
-qkmer_length_internal_spg(const QKmer *q)
-{
-    Size size   = VARSIZE_ANY(q);
-    Size header = offsetof(QKmer, data);
+    out->nodeLabels = (Datum *) palloc(sizeof(Datum) * out->nNodes);
+    for (i = 0; i < out->nNodes; i++)
+        out->nodeLabels[i] = Int16GetDatum(labels[i]);
 
-    if (size < header)
-        ereport(ERROR,
-                (errcode(ERRCODE_DATA_CORRUPTED),
-                 errmsg("qkmer value is corrupted")));
-    return (int) (size - header);
+    for (i = 0; i < in->nTuples; i++)
+        out->mapTuplesToNodes[i] = nodeOf[out->mapTuplesToNodes[i] + 2];
+
+    PG_RETURN_VOID();
 }
 
-// IUPAC qkmer code
+
+// does cmp = kmer_cmp(value, query) satisfy a btree comparison strategy?
 static inline bool
-qbase_matches_spg(char q, char base)
+kmer_range_matches(StrategyNumber strategy, int cmp)
 {
-    switch (q)
+    switch (strategy)
     {
-        case 'A': return base == 'A';
-        case 'C': return base == 'C';
-        case 'G': return base == 'G';
-        case 'T': return base == 'T';
-
-        case 'N': return (base == 'A' || base == 'C' || base == 'G' || base == 'T');
-        case 'R': return (base == 'A' || base == 'G');
-        case 'Y': return (base == 'C' || base == 'T');
-        case 'S': return (base == 'G' || base == 'C');
-        case 'W': return (base == 'A' || base == 'T');
-        case 'K': return (base == 'G' || base == 'T');
-        case 'M': return (base == 'A' || base == 'C');
-        case 'B': return (base == 'C' || base == 'G' || base == 'T');
-        case 'D': return (base == 'A' || base == 'G' || base == 'T');
-        case 'H': return (base == 'A' || base == 'C' || base == 'T');
-        case 'V': return (base == 'A' || base == 'C' || base == 'G');
-
-        default:
-            ereport(ERROR,
-                    (errcode(ERRCODE_DATA_CORRUPTED),
-                     errmsg("qkmer contains invalid IUPAC code '%c'", q)));
-            return false;
+        case BTLessStrategyNumber:         return cmp < 0;
+        case BTLessEqualStrategyNumber:    return cmp <= 0;
+        case BTGreaterEqualStrategyNumber: return cmp >= 0;
+        case BTGreaterStrategyNumber:      return cmp > 0;
+        default:                           return true;
     }
 }
 
-// map index child
-static inline char
-child_index_to_base(int nodeN)
+/*
+ * Range pruning relies on the trie being in kmer order (A<C<G<T, a prefix
+ * before its extensions). Unless path is a prefix of the query, every value
+ * below it compares to the query the same way path does. If path equals
+ * the query, the values below it are the query itself or longer ones.
+ */
+static bool
+kmer_node_in_range(StrategyNumber strategy, Kmer query, Kmer path, bool isEnd)
 {
-    switch (nodeN)
-    {
-        case 0: return 'A';
-        case 1: return 'C';
-        case 2: return 'G';
-        case 3: return 'T';
-        default: return '\0';  //end
-    }
-}
+    int plen = kmer_length_internal(path);
+    int qlen = kmer_length_internal(query);
 
+    if (isEnd || plen > qlen ||
+        (plen > 0 && !kmer_has_prefix_internal(query, path, plen)))
+        return kmer_range_matches(strategy, kmer_cmp_internal(path, query));
 
-Datum
-spg_kmer_inner_consistent(PG_FUNCTION_ARGS)
-{
-    spgInnerConsistentIn  *in  = (spgInnerConsistentIn *) PG_GETARG_POINTER(0);
-    spgInnerConsistentOut *out = (spgInnerConsistentOut *) PG_GETARG_POINTER(1);
-    int nVisit = 0;
-    ScanKey        key;
-    StrategyNumber strategy;
+    if (plen == qlen)
+        return strategy != BTLessStrategyNumber;
 
-    elog(WARNING, "inner_consistent called: level=%d, nNodes=%d, nkeys=%d",
-         in->level, in->nNodes, in->nkeys);
+    // below a proper prefix of the query there are values on both sides
+    return true;
+}
 
-    // not used
-    out->reconstructedValues = NULL;
-    out->traversalValues     = NULL;
-    out->distances           = NULL;
+// can a child below path (exactly path when isEnd) hold query itself?
+static bool
+kmer_node_may_equal(Kmer query, Kmer path, int plen, bool isEnd)
+{
+    int qlen = kmer_length_internal(query);
+
+    if (plen > qlen || (isEnd && plen != qlen))
+        return false;
+    return plen == 0 || kmer_has_prefix_internal(query, path, plen);
+}
 
-    // allcate to visit potential childeren
-    out->nodeNumbers = (int *) palloc(sizeof(int) * in->nNodes); //worst case visit all childeren so e allocate nNode * int
-    out->levelAdds   = (int *) palloc(sizeof(int) * in->nNodes);
+/*
+ * qkmer arguments of the scan keys, detoasted once per inner tuple rather
+ * than once per child (NULL for the other strategies). NULL, and nothing
+ * allocated, when no key is a qkmer.
+ */
+static QKmer **
+detoast_qkmer_keys(ScanKey keys, int nkeys)
+{
+    QKmer **patterns = NULL;
 
-    //without search key (WHERE) we cann't prune anything so we just visit all
-    if (in->nkeys == 0|| in->allTheSame)
+    for (int i = 0; i < nkeys; i++)
     {
-        for (int i = 0; i < in->nNodes; i++)
-        {
-            out->nodeNumbers[nVisit] = i;
-            out->levelAdds[nVisit]   = 1;  // we go down a level
-            nVisit++;
-        }
-        out->nNodes = nVisit;
-        PG_RETURN_VOID();
+        if (keys[i].sk_strategy != KMER_QKMER_CONTAINS_STRATEGY)
+            continue;
+        if (patterns == NULL)
+            patterns = (QKmer **) palloc0(sizeof(QKmer *) * nkeys);
+        patterns[i] = (QKmer *) PG_DETOAST_DATUM(keys[i].sk_argument);
     }
+    return patterns;
+}
 
-    //  we just prune using the first cond key : WHERE <cond1> AND <cond2>. to guide the pruning
-    // (can be optimized to prune more)
-    // with = we prune more agresively because there is only one possible path at each level
-    key      = &in->scankeys[0];
-    strategy = key->sk_strategy; // get the strategy number of the operator
+/*
+ * Can a child whose values all start with path (and are exactly path when
+ * isEnd) hold a match for key? The first `checked` bases of path were
+ * already tested one level up. pattern is the detoasted qkmer argument.
+ */
+static bool
+kmer_node_consistent(ScanKey key, const QKmer *pattern, Kmer path, bool isEnd, int checked)
+{
+    int plen = kmer_length_internal(path);
 
-     //strat k = query_kmer (handle WHERE k = ...) type of queries
-    if (strategy == BTEqualStrategyNumber) // if operator is =
+    switch (key->sk_strategy)
     {
-        Kmer *q = (Kmer *) PG_DETOAST_DATUM(key->sk_argument);
-        int   qlen;
-        int nodeN;
-
-        qlen = q->length;
+        case BTEqualStrategyNumber:
+            return kmer_node_may_equal(DatumGetKmer(key->sk_argument), path, plen, isEnd);
 
-        if (in->level < qlen)
+        case KMER_CANONICAL_EQUAL_STRATEGY:
         {
-            nodeN = kmer_node_for_level(q, in->level); //gives us the exact child to follow so we don't visit all childeren nodes
+            // either strand: two equality descents in one
+            Kmer query = DatumGetKmer(key->sk_argument);
+
+            return kmer_node_may_equal(query, path, plen, isEnd) ||
+                   kmer_node_may_equal(kmer_revcomp_internal(query), path, plen, isEnd);
         }
-        else
+
+        case KMER_PREFIX_CONTAINS_STRATEGY:
         {
-            //we have consumed everything : end
-            nodeN = 4;
+            Kmer prefix = DatumGetKmer(key->sk_argument);
+            int  n      = Min(plen, kmer_length_internal(prefix));
+
+            // values shorter than the prefix are never followed
+            if (isEnd && plen < kmer_length_internal(prefix))
+                return false;
+            return n == 0 || kmer_has_prefix_internal(prefix, path, n);
         }
 
-        if (nodeN >= 0 && nodeN < in->nNodes)
+        case KMER_QKMER_CONTAINS_STRATEGY:
         {
-            out->nodeNumbers[nVisit] = nodeN;
-            out->levelAdds[nVisit]   = 1;
-            nVisit++;
+            int qlen = qkmer_length_internal(pattern);
+
+            if (plen > qlen || (isEnd && plen != qlen))
+                return false;
+            return qkmer_matches_range(pattern, path, checked, plen);
         }
 
-        out->nNodes = nVisit;
+        case BTLessStrategyNumber:
+        case BTLessEqualStrategyNumber:
+        case BTGreaterEqualStrategyNumber:
+        case BTGreaterStrategyNumber:
+            return kmer_node_in_range(key->sk_strategy, DatumGetKmer(key->sk_argument),
+                                      path, isEnd);
+
+        default:
+            // unknown strategy: leave it to the leaf check
+            return true;
     }
+}
 
-     //prefic k starts_with prefix ^@ operator
-    // less agressive pruning due to the fact that we have to return a set with multiple branches
-    else if (strategy == KMER_PREFIX_CONTAINS_STRATEGY	)
-    {
-        Kmer *prefix = (Kmer *) PG_DETOAST_DATUM(key->sk_argument);
-        int   plen;
+/*
+ * Lower bound of the Hamming distance between query and the values below a
+ * child: the mismatches along its path, plus the bases the path already
+ * has beyond the end of the query. An END child holds exactly path.
+ * Children are expanded best-first on this bound, so a KNN scan only opens
+ * subtrees that could beat the rows it has already returned.
+ */
+static double
+kmer_node_distance(Kmer query, Kmer path, bool isEnd)
+{
+    int plen = kmer_length_internal(path);
+    int qlen = kmer_length_internal(query);
 
-        plen = prefix->length;
+    if (isEnd)
+        return kmer_hamming_internal(path, query);
 
-        if (in->level < plen)
-        {
-            //while we have not explored all the prefixe on the path we continue on the correponding base
-            int nodeN = kmer_node_for_level(prefix, in->level); // same as = operator but until we reach prefix lenght then we explore all
+    return kmer_mismatches_internal(path, query, Min(plen, qlen)) + Max(plen - qlen, 0);
+}
 
-            if (nodeN >= 0 && nodeN < in->nNodes)
-            {
-                out->nodeNumbers[nVisit] = nodeN;
-                out->levelAdds[nVisit]   = 1;
-                nVisit++;
-            }
-        }
-        else
-        {
-             // entire prefixe on the path we followed all the base
-            for (int i = 0; i < in->nNodes; i++) // since we aleardy mateched the prefixe, now we just have from there visit everything
-            {
-                out->nodeNumbers[nVisit] = i;
-                out->levelAdds[nVisit]   = 1;
-                nVisit++;
-            }
-        }
 
-        out->nNodes = nVisit;
+Datum
+spg_kmer_inner_consistent(PG_FUNCTION_ARGS)
+{
+    spgInnerConsistentIn  *in  = (spgInnerConsistentIn *) PG_GETARG_POINTER(0);
+    spgInnerConsistentOut *out = (spgInnerConsistentOut *) PG_GETARG_POINTER(1);
+    QKmer **patterns = detoast_qkmer_keys(in->scankeys, in->nkeys);
+    Kmer    base;
+    int     prefixLen = 0;
+    int     nVisit = 0;
+
+    // path down to this tuple, plus its prefix
+    base = reconstructed_path(in->level, in->reconstructedValue);
+    if (in->hasPrefix)
+    {
+        Kmer prefix = DatumGetKmer(in->prefixDatum);
+
+        prefixLen = kmer_length_internal(prefix);
+        base = frag_concat(base, prefix);
     }
-    // qkmer
-	else if (strategy == KMER_QKMER_CONTAINS_STRATEGY)
-	{
-	QKmer *pattern;
-	int    plen;
-	int    level;
-	int    i;
-
-   		 //get kmer of the request
-		pattern = (QKmer *) PG_DETOAST_DATUM(key->sk_argument);
-	    plen    = qkmer_length_internal_spg(pattern);
-	    level   = in->level;
-
-
-    	if (level >= plen)
-    	{
-        	for (i = 0; i < in->nNodes; i++)
-        	{
-        	    out->nodeNumbers[nVisit] = i;
-        	    out->levelAdds[nVisit]   = 1;
-        	    nVisit++;
-        	}
-    	}
-    	else
-    	{
-      		char q;
-
-        	q = pattern->data[level];
-
-
-        	for (i = 0; i < in->nNodes; i++)
-        	{
-           		int  child = i;
-            	char base  = child_index_to_base(child);
-
-            	if (base == '\0')
-            	{
-
-                	out->nodeNumbers[nVisit] = child;
-                	out->levelAdds[nVisit]   = 1;
-                	nVisit++;
-            	}
-            	else
-            	{
-
-                	if (qbase_matches_spg(q, base))
-                	{
-                    	out->nodeNumbers[nVisit] = child;
-                    	out->levelAdds[nVisit]   = 1;
-                    	nVisit++;
-                	}
-            	}
-        	}
-    	}
-
-    	out->nNodes = nVisit;
-	}
-
-    //evrything else  we just visit all childeren
-    else
+
+    out->traversalValues = NULL;
+    out->distances       = NULL;
+
+    // worst case we visit all children
+    out->nodeNumbers         = (int *) palloc(sizeof(int) * in->nNodes);
+    out->levelAdds           = (int *) palloc(sizeof(int) * in->nNodes);
+    out->reconstructedValues = (Datum *) palloc(sizeof(Datum) * in->nNodes);
+    if (in->norderbys > 0)
+        out->distances = (double **) palloc(sizeof(double *) * in->nNodes);
+
+    for (int i = 0; i < in->nNodes; i++)
     {
-        for (int i = 0; i < in->nNodes; i++) //just visits verything in a bfs way
+        int16 label = DatumGetInt16(in->nodeLabels[i]);
+        Kmer  path  = base;
+        int   levelAdd = prefixLen;
+        bool  visit = true;
+
+        if (label >= 0)
         {
-            out->nodeNumbers[nVisit] = i;
-            out->levelAdds[nVisit]   = 1;
-            nVisit++;
+            path = frag_append(base, label);
+            levelAdd++;
         }
-        out->nNodes = nVisit;
-    }
 
-    PG_RETURN_VOID();
-}
+        // WHERE <cond1> AND <cond2> ...: the child must be able to satisfy every key
+        for (int j = 0; j < in->nkeys && visit; j++)
+            visit = kmer_node_consistent(&in->scankeys[j], patterns ? patterns[j] : NULL, path,
+                                         label == KMER_NODE_END, in->level);
+        if (!visit)
+            continue;
 
-//small helper (strcit equality)
-static bool
-kmer_equal_internal(const Kmer *a, const Kmer *b)
-{
-    if (a->length != b->length)
-        return false;
+        out->nodeNumbers[nVisit]         = i;
+        out->levelAdds[nVisit]           = levelAdd;
+        out->reconstructedValues[nVisit] = KmerGetDatum(path);
 
-    for (int i = 0; i < a->length; i++)
-    {
-        if (kmer_get_base(a, i) != kmer_get_base(b, i))
-            return false;
+        if (in->norderbys > 0)
+        {
+            double *distances = (double *) palloc(sizeof(double) * in->norderbys);
+
+            for (int j = 0; j < in->norderbys; j++)
+                distances[j] = kmer_node_distance(DatumGetKmer(in->orderbys[j].sk_argument),
+                                                  path, label == KMER_NODE_END);
+            out->distances[nVisit] = distances;
+        }
+        nVisit++;
     }
-    return true;
+    out->nNodes = nVisit;
+
+    count_inner_visit(in, out);
+
+    PG_RETURN_VOID();
 }
 
+// prefix longer than the value is an error, as for the ^@ operator
 static bool
-kmer_starts_with_internal(const Kmer *prefix, const Kmer *value)
+kmer_starts_with_checked(Kmer prefix, Kmer value)
 {
-    int np = prefix->length;
-    int nv = value->length;
+    int np = kmer_length_internal(prefix);
+    int nv = kmer_length_internal(value);
 
     if (np > nv)
         ereport(ERROR,
@@ -403,12 +598,7 @@ kmer_starts_with_internal(const Kmer *prefix, const Kmer *value)
                  errmsg("starts_with: prefix length %d exceeds kmer length %d",
                         np, nv)));
 
-    for (int i = 0; i < np; i++)
-    {
-        if (kmer_get_base(prefix, i) != kmer_get_base(value, i))
-            return false;
-    }
-    return true;
+    return kmer_has_prefix_internal(value, prefix, np);
 }
 
 //applies all condition : if one fails the leaf is rejected else accepted
@@ -420,19 +610,31 @@ spg_kmer_leaf_consistent(PG_FUNCTION_ARGS)
 
     bool res = true;
     int  i;
-    Kmer *leaf;
+    Kmer leaf;
 
-    //leaf value
-    out->leafValue        = in->leafDatum;
+    // the leaf only stores the bases below the path
+    leaf = frag_concat(reconstructed_path(in->level, in->reconstructedValue),
+                       DatumGetKmer(in->leafDatum));
+
+    out->leafValue        = KmerGetDatum(leaf);
     out->recheck          = false;
     out->recheckDistances = false;
 
+    // ORDER BY kmer <-> query: exact Hamming distances
+    if (in->norderbys > 0)
+    {
+        out->distances = (double *) palloc(sizeof(double) * in->norderbys);
+        for (i = 0; i < in->norderbys; i++)
+            out->distances[i] = kmer_hamming_internal(leaf,
+                                                      DatumGetKmer(in->orderbys[i].sk_argument));
+    }
+
     // no key -> evrything matches
     if (in->nkeys == 0)
+    {
+        count_leaf_test(true);
         PG_RETURN_BOOL(true);
-
-    //kmer of the leaf
-    leaf = (Kmer *) PG_DETOAST_DATUM(in->leafDatum);
+    }
 
     for (i = 0; i < in->nkeys; i++)
     {
@@ -441,54 +643,53 @@ spg_kmer_leaf_consistent(PG_FUNCTION_ARGS)
 
         if (strategy == BTEqualStrategyNumber)
         {
-            Kmer *query = (Kmer *) PG_DETOAST_DATUM(key->sk_argument);
+            Kmer query = DatumGetKmer(key->sk_argument);
 
-            if (!kmer_equal_internal(leaf, query))
+            if (!kmer_eq_internal(leaf, query))
             {
                 res = false;
                 break;
             }
         }
-        else if (strategy == KMER_PREFIX_CONTAINS_STRATEGY)
+        else if (strategy == KMER_CANONICAL_EQUAL_STRATEGY)
         {
-            Kmer *prefix = (Kmer *) PG_DETOAST_DATUM(key->sk_argument);
+            Kmer query = DatumGetKmer(key->sk_argument);
 
-            if (!kmer_starts_with_internal(prefix, leaf))
+            if (kmer_canonical_internal(leaf) != kmer_canonical_internal(query))
             {
                 res = false;
                 break;
             }
         }
-        else if (strategy == KMER_QKMER_CONTAINS_STRATEGY)
+        else if (strategy == KMER_PREFIX_CONTAINS_STRATEGY)
         {
+            Kmer prefix = DatumGetKmer(key->sk_argument);
 
-
-            QKmer *pattern   = (QKmer *) PG_DETOAST_DATUM(key->sk_argument);
-            int    plen      = qkmer_length_internal_spg(pattern);
-            int    klen      = leaf->length;
-            int    pos;
-            bool   ok = true;
-
-            // same lenght
-            if (plen != klen)
+            if (!kmer_starts_with_checked(prefix, leaf))
             {
                 res = false;
                 break;
             }
+        }
+        else if (strategy == KMER_QKMER_CONTAINS_STRATEGY)
+        {
+            // one test per leaf: detoast here, only for qkmer keys
+            QKmer *pattern = (QKmer *) PG_DETOAST_DATUM(key->sk_argument);
 
-            for (pos = 0; pos < plen; pos++)
+            if (!qkmer_matches_kmer(pattern, leaf))
             {
-                char q = pattern->data[pos];   //iupac
-                char b = kmer_get_base(leaf, pos);  //ACGT
-
-                if (!qbase_matches_spg(q, b))
-                {
-                    ok = false;
-                    break;
-                }
+                res = false;
+                break;
             }
+        }
+        else if (strategy == BTLessStrategyNumber ||
+                 strategy == BTLessEqualStrategyNumber ||
+                 strategy == BTGreaterEqualStrategyNumber ||
+                 strategy == BTGreaterStrategyNumber)
+        {
+            Kmer query = DatumGetKmer(key->sk_argument);
 
-            if (!ok)
+            if (!kmer_range_matches(strategy, kmer_cmp_internal(leaf, query)))
             {
                 res = false;
                 break;
@@ -500,5 +701,7 @@ spg_kmer_leaf_consistent(PG_FUNCTION_ARGS)
         }
     }
 
+    count_leaf_test(res);
+
     PG_RETURN_BOOL(res);
 }
@@ -0,0 +1,25 @@
+#ifndef SPGIST_KMER_H
+#define SPGIST_KMER_H
+
+#include "postgres.h"
+
+/*
+ * Opt-in SP-GiST scan instrumentation (pg_dna.track_scan_stats).
+ * Counters are backend-local and cumulative until pg_dna_scan_stats(true)
+ * resets them; in a parallel scan only the leader's share is counted.
+ */
+typedef struct KmerScanStats
+{
+    int64 inner_visited;    // inner tuples passed to inner_consistent
+    int64 nodes_descended;  // child nodes returned for a visit
+    int64 nodes_pruned;     // child nodes skipped
+    int64 leaves_tested;    // leaf tuples passed to leaf_consistent
+    int64 leaves_matched;   // leaf tuples accepted
+} KmerScanStats;
+
+extern bool          kmer_track_scan_stats;
+extern KmerScanStats kmer_scan_stats;
+
+extern void spg_kmer_init(void);
+
+#endif
@@ -0,0 +1,46 @@
+-- Tests for binary send/receive of dna, kmer and qkmer
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+SELECT '--- send format ---' AS section;
+
+SELECT dna_send('ACGT'::dna);
+SELECT dna_send('ACGTA'::dna);
+SELECT kmer_send('ACGT'::kmer);
+SELECT qkmer_send('ANR'::qkmer);
+
+SELECT '--- binary COPY round trip ---' AS section;
+
+DROP TABLE IF EXISTS test_binary_src, test_binary_dst;
+CREATE TABLE test_binary_src (d dna, k kmer, q qkmer);
+CREATE TABLE test_binary_dst (LIKE test_binary_src);
+
+INSERT INTO test_binary_src VALUES
+    ('A', 'A', 'N'),
+    ('ACGTACGTAC', 'ACGTACGTACGTACGTACGTACGTACGTACG', 'NRYSWKMBDHVACGT'),
+    (repeat('GATTACA', 100), 'TTTT', repeat('N', 32));
+
+COPY test_binary_src TO '/tmp/pg_dna_test_binary.copy' (FORMAT binary);
+COPY test_binary_dst FROM '/tmp/pg_dna_test_binary.copy' (FORMAT binary);
+
+DO $$
+DECLARE
+    diff int;
+BEGIN
+    SELECT count(*) INTO diff
+    FROM (SELECT d::text, k::text, q::text FROM test_binary_src
+          EXCEPT
+          SELECT d::text, k::text, q::text FROM test_binary_dst) AS x;
+
+    IF diff <> 0 THEN
+        RAISE EXCEPTION 'binary COPY round trip changed % rows', diff;
+    END IF;
+END;
+$$;
+
+DROP TABLE test_binary_src, test_binary_dst;
+
+SELECT '--- DONE ---' AS section;
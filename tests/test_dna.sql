@@ -104,4 +104,73 @@ SELECT '--- Large sequences ---' AS section;
 SELECT dna_length(repeat('ACGT', 25)::dna);
 SELECT dna_get(repeat('ACGT', 25)::dna, 87);
 
+SELECT '--- Substrings ---' AS section;
+
+SELECT dna_substr('ACGTTGCA'::dna, 3, 4);
+SELECT dna_substr('ACGTTGCA'::dna, 0, 3);
+SELECT dna_substr('ACGTTGCA'::dna, 6, 10);
+SELECT dna_length(dna_substr('ACGTTGCA'::dna, 20, 5));
+SELECT substr('ACGTTGCA'::dna, 2, 3);
+
+-- out-of-line value: only the needed toast chunks are read
+CREATE TEMP TABLE big_seq AS
+SELECT s AS txt, s::dna AS seq
+FROM (SELECT string_agg(substr('ACGT', (i * 7919 % 13) % 4 + 1, 1), '' ORDER BY i) AS s
+      FROM generate_series(1, 200000) AS i) AS g;
+
+SELECT bool_and(dna_substr(seq, st, l)::text = substr(txt, st, l))
+FROM big_seq, (VALUES (1, 10), (2, 7), (99999, 33), (150003, 4096), (199990, 20)) AS r(st, l);
+SELECT bool_and(dna_get(seq, i) = substr(txt, i, 1))
+FROM big_seq, generate_series(1, 200000, 9973) AS i;
+SELECT dna_length(seq) FROM big_seq;
+
+DO $$
+BEGIN
+    BEGIN
+        PERFORM dna_substr('ACGT'::dna, 1, -1);
+        RAISE EXCEPTION 'ERROR EXPECTED: negative length';
+    EXCEPTION WHEN others THEN
+        -- OK
+    END;
+END;
+$$;
+
+SELECT '--- Block encode/decode ---' AS section;
+
+-- lengths around the 16/32-base kernel blocks, mixed case
+SELECT bool_and((repeat('acgTTGcA', n) || 'GAT')::dna::text
+                = upper(repeat('acgTTGcA', n)) || 'GAT')
+FROM generate_series(0, 20) AS n;
+
+DO $$
+BEGIN
+    BEGIN
+        PERFORM (repeat('ACGT', 17) || 'N' || repeat('ACGT', 17))::dna;
+        RAISE EXCEPTION 'ERROR EXPECTED: invalid base N inside a SIMD block';
+    EXCEPTION WHEN others THEN
+        -- OK
+    END;
+END;
+$$;
+
+SELECT '--- Substring search ---' AS section;
+
+SELECT dna_contains('ACGTTGCA'::dna, 'TTG'::dna);
+SELECT dna_contains('ACGTTGCA'::dna, 'TTT'::dna);
+SELECT dna_position('ACGTTGCA'::dna, 'GCA'::dna);
+SELECT dna_position('ACGTTGCA'::dna, 'AAA'::dna);
+SELECT dna_position('ACGTTGCA'::dna, 'ANGT'::qkmer);
+SELECT array_agg(p) FROM dna_find_all('AAAAA'::dna, 'AA'::dna) AS p;
+SELECT array_agg(p) FROM dna_find_all('ACGTACGTAC'::dna, 'RYG'::qkmer) AS p;
+
+-- patterns longer than the 61-base shift-or word are verified past it
+SELECT dna_position((repeat('A', 100) || repeat('ACGT', 20) || 'G')::dna,
+                    (repeat('ACGT', 20) || 'G')::dna);
+SELECT dna_contains((repeat('ACGT', 30))::dna, (repeat('ACGT', 20) || 'G')::dna);
+
+-- agrees with strpos on the text form, for every pattern of a sequence
+SELECT bool_and(dna_position(s::dna, substr(s, i, l)::dna) = strpos(s, substr(s, i, l)))
+FROM (SELECT 'GATTACACCGTAGGCTTAACGTAGCATTGACCAGT' AS s) AS seq,
+     generate_series(1, 30) AS i, generate_series(1, 6) AS l;
+
 SELECT '--- DONE ---' AS section;
@@ -0,0 +1,90 @@
+-- Checks the large-object (chunked) dna storage against the same sequence
+-- held as one dna value
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+\echo 'loading a 378 kbp sequence in 37 pieces of uneven length'
+
+SELECT setseed(0.5);
+
+CREATE TEMP TABLE lo_pieces AS
+SELECT p, string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '' ORDER BY b) AS txt
+FROM generate_series(1, 37) AS p,
+LATERAL generate_series(1, 1 + (p * 65537) % 64999) AS b
+GROUP BY p;
+
+CREATE TEMP TABLE lo_seq (lo oid, whole dna, txt text);
+
+DO $$
+DECLARE
+    lo oid := dna_lo_create();
+    r  record;
+BEGIN
+    FOR r IN SELECT txt FROM lo_pieces ORDER BY p LOOP
+        PERFORM dna_lo_append(lo, r.txt::dna);
+    END LOOP;
+    INSERT INTO lo_seq
+    SELECT lo, string_agg(txt, '' ORDER BY p)::dna, string_agg(txt, '' ORDER BY p)
+    FROM lo_pieces;
+END;
+$$;
+
+SELECT '--- length ---' AS section;
+
+SELECT dna_lo_length(lo) = length(txt) FROM lo_seq;
+CREATE TEMP TABLE lo_empty AS SELECT dna_lo_create() AS lo;
+SELECT dna_lo_length(lo) FROM lo_empty;
+
+SELECT '--- substr ---' AS section;
+
+SELECT bool_and(dna_lo_substr(lo, st, l)::text = substr(txt, st::int, l))
+FROM lo_seq, (VALUES (1, 10), (3, 7), (65000, 70000), (300001, 4096),
+                     (0, 5), (378240, 50)) AS r(st, l);
+
+SELECT '--- kmers ---' AS section;
+
+SELECT count(*) = length(txt) - 20 FROM lo_seq, dna_lo_kmers(lo, 21) GROUP BY txt;
+SELECT bool_and(k.kmer = g.kmer AND k.pos = g.pos)
+FROM lo_seq,
+     LATERAL (SELECT * FROM dna_lo_kmers(lo, 11) LIMIT 5000) AS k
+     JOIN LATERAL generate_kmers_positions(whole, 11) AS g ON g.pos = k.pos;
+
+SELECT '--- search ---' AS section;
+
+SELECT dna_lo_position(lo, substr(txt, 277777, 40)::dna) <= 277777 FROM lo_seq;
+SELECT array_agg(f ORDER BY f) = (SELECT array_agg(p::bigint ORDER BY p) FROM dna_find_all(whole, 'ACGTACGTA'::dna) AS p)
+FROM lo_seq, dna_lo_find_all(lo, 'ACGTACGTA'::dna) AS f GROUP BY whole;
+SELECT (SELECT count(*) FROM dna_lo_find_all(lo, 'TATAWAWR'::qkmer))
+     = (SELECT count(*) FROM dna_find_all(whole, 'TATAWAWR'::qkmer))
+FROM lo_seq;
+
+SELECT '--- unaligned append ---' AS section;
+
+-- 1.2 Mbp (more than one reader chunk) after 3 bases: every byte is shifted
+CREATE TEMP TABLE lo_big AS SELECT dna_lo_create() AS lo;
+SELECT dna_lo_append(lo, 'GGA'::dna) FROM lo_big;
+SELECT dna_lo_append(lo, repeat('ACGT', 300000)::dna) FROM lo_big;
+SELECT dna_lo_substr(lo, 1, 8)::text = 'GGAACGTA'
+   AND dna_lo_substr(lo, 1048570, 12)::text = substr('GGA' || repeat('ACGT', 300000), 1048570, 12)
+   AND dna_lo_substr(lo, 1199996, 10)::text = substr('GGA' || repeat('ACGT', 300000), 1199996, 10)
+FROM lo_big;
+
+DO $$
+BEGIN
+    BEGIN
+        PERFORM dna_lo_length(lo_from_bytea(0, '\x00'::bytea));
+        RAISE EXCEPTION 'ERROR EXPECTED: not a dna large object';
+    EXCEPTION WHEN others THEN
+        -- OK
+    END;
+END;
+$$;
+
+SELECT lo_unlink(lo) FROM lo_seq;
+SELECT lo_unlink(lo) FROM lo_empty;
+SELECT lo_unlink(lo) FROM lo_big;
+
+SELECT '--- DONE ---' AS section;
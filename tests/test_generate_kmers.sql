@@ -50,6 +50,84 @@ BEGIN
 END;
 $$;
 
+SELECT '--- windows match substrings (packed rolling window) ---' AS section;
+
+DO $$
+DECLARE
+    seq text := repeat('ACGTTGCAAGCTTAGGCATC', 7) || 'GATTACA';
+    k   int;
+    res text[];
+    exp text[];
+BEGIN
+    FOREACH k IN ARRAY ARRAY[1, 2, 3, 4, 5, 7, 8, 16, 31] LOOP
+        SELECT array_agg(kmer::text) INTO res
+        FROM generate_kmers(seq::dna, k) AS g(kmer);
+
+        SELECT array_agg(substr(seq, i, k) ORDER BY i) INTO exp
+        FROM generate_series(1, length(seq) - k + 1) AS i;
+
+        IF res IS DISTINCT FROM exp THEN
+            RAISE EXCEPTION 'k=%: unexpected k-mers: %', k, res;
+        END IF;
+    END LOOP;
+END;
+$$;
+
+SELECT '--- positions and strands (materialize mode) ---' AS section;
+
+DO $$
+DECLARE
+    res text[];
+BEGIN
+    SELECT array_agg(kmer::text || '@' || pos || strand) INTO res
+    FROM generate_kmers_positions('ACGTAC'::dna, 3);
+
+    IF res IS DISTINCT FROM ARRAY['ACG@1+','CGT@2+','GTA@3+','TAC@4+']::text[] THEN
+        RAISE EXCEPTION 'unexpected forward k-mers: %', res;
+    END IF;
+
+    SELECT array_agg(kmer::text || '@' || pos || strand) INTO res
+    FROM generate_kmers_positions('AACGTT'::dna, 4, both_strands => true);
+
+    IF res IS DISTINCT FROM ARRAY['AACG@1+','CGTT@1-','ACGT@2+','ACGT@2-',
+                                  'CGTT@3+','AACG@3-']::text[] THEN
+        RAISE EXCEPTION 'unexpected two-strand k-mers: %', res;
+    END IF;
+
+    SELECT coalesce(array_agg(kmer::text), '{}'::text[]) INTO res
+    FROM generate_kmers_positions('AC'::dna, 3);
+
+    IF res IS DISTINCT FROM '{}'::text[] THEN
+        RAISE EXCEPTION 'expected empty result, got %', res;
+    END IF;
+END;
+$$;
+
+SELECT '--- canonical k-mers ---' AS section;
+
+DO $$
+DECLARE
+    res text[];
+BEGIN
+    -- AACG/CGTT and ACGT are reverse complements of each other
+    SELECT array_agg(kmer::text) INTO res
+    FROM generate_kmers('AACGTT'::dna, 4, canonical => true) AS k(kmer);
+
+    IF res IS DISTINCT FROM ARRAY['AACG','ACGT','AACG']::text[] THEN
+        RAISE EXCEPTION 'unexpected canonical k-mers: %', res;
+    END IF;
+
+    IF EXISTS (
+        SELECT 1
+        FROM generate_kmers('GATTACAGGCTTAACCGT'::dna, 7, canonical => true) WITH ORDINALITY AS c(kmer, i)
+        JOIN generate_kmers('GATTACAGGCTTAACCGT'::dna, 7) WITH ORDINALITY AS f(kmer, i) USING (i)
+        WHERE c.kmer IS DISTINCT FROM kmer_canonical(f.kmer)
+    ) THEN
+        RAISE EXCEPTION 'canonical mode differs from kmer_canonical';
+    END IF;
+END;
+$$;
+
 SELECT '--- error cases ---' AS section;
 
 DO $$
@@ -0,0 +1,118 @@
+-- Checks the GIN opclass on dna against sequential scans
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+\echo 'building 2 000 random contigs (20..2000 bases)'
+
+SELECT setseed(0.25);
+
+DROP TABLE IF EXISTS test_gin_contigs;
+CREATE TABLE test_gin_contigs (
+    id   serial PRIMARY KEY,
+    seq  dna NOT NULL
+);
+
+INSERT INTO test_gin_contigs (seq)
+SELECT string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '')::dna
+FROM generate_series(1, 2000) AS c,
+LATERAL generate_series(1, 20 + floor(random() * 1980)::int) AS b
+GROUP BY c;
+
+SELECT '--- operators ---' AS section;
+
+SELECT 'ACGTACGT'::dna @> 'GTAC'::kmer;
+SELECT 'ACGTACGT'::dna @> 'GTTC'::kmer;
+SELECT 'ACGTACGT'::dna @> 'ACGTACGT'::kmer;
+SELECT 'ACGTACGT'::dna @> 'ACGTACGTA'::kmer;
+SELECT 'ACGTACGT'::dna @> 'GNAY'::qkmer;
+SELECT 'ACGTACGT'::dna @> 'GNAG'::qkmer;
+
+-- probes: substrings of some contigs (hits) and random kmers (mostly misses)
+CREATE TEMP TABLE test_gin_probes AS
+SELECT substr(seq::text, 1 + floor(random() * greatest(length(seq) - 30, 1))::int,
+              (ARRAY[3, 8, 12, 16, 25])[1 + (id % 5)]) AS probe
+FROM test_gin_contigs
+WHERE id % 100 = 0
+UNION ALL
+SELECT string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '')
+FROM generate_series(1, 10) AS p, generate_series(1, 14) AS b
+GROUP BY p;
+
+-- Runs q under a seq scan and under a bitmap index scan and compares the results
+CREATE FUNCTION pg_temp.check_gin(q text) RETURNS void AS $$
+DECLARE
+    plan      text := '';
+    line      text;
+    seq_res   text;
+    index_res text;
+BEGIN
+    PERFORM set_config('enable_seqscan', 'on', true);
+    PERFORM set_config('enable_bitmapscan', 'off', true);
+    EXECUTE q INTO seq_res;
+
+    PERFORM set_config('enable_seqscan', 'off', true);
+    PERFORM set_config('enable_bitmapscan', 'on', true);
+    FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || q LOOP
+        plan := plan || line || E'\n';
+    END LOOP;
+    IF position('Bitmap Index Scan' IN plan) = 0 THEN
+        RAISE EXCEPTION 'expected a GIN bitmap scan for %, got:%', q, E'\n' || plan;
+    END IF;
+    EXECUTE q INTO index_res;
+
+    IF seq_res IS DISTINCT FROM index_res THEN
+        RAISE EXCEPTION 'GIN scan and seq scan disagree for %', q;
+    END IF;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION pg_temp.check_all_probes() RETURNS void AS $$
+DECLARE
+    p text;
+BEGIN
+    FOR p IN SELECT probe FROM test_gin_probes LOOP
+        PERFORM pg_temp.check_gin(format(
+            'SELECT string_agg(id::text, '','' ORDER BY id) FROM test_gin_contigs WHERE seq @> %L::kmer', p));
+        PERFORM pg_temp.check_gin(format(
+            'SELECT string_agg(id::text, '','' ORDER BY id) FROM test_gin_contigs WHERE seq @> %L::qkmer',
+            overlay(p PLACING 'N' FROM 1 + length(p) / 2 FOR 1)));
+    END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT '--- default keys (k = 12) ---' AS section;
+
+CREATE INDEX test_gin_contigs_idx ON test_gin_contigs USING gin (seq);
+SELECT pg_temp.check_all_probes();
+DROP INDEX test_gin_contigs_idx;
+
+SELECT '--- sampled keys (k = 8, minimizer_window = 5) ---' AS section;
+
+CREATE INDEX test_gin_contigs_idx ON test_gin_contigs
+    USING gin (seq dna_gin_ops (k = 8, minimizer_window = 5));
+SELECT pg_temp.check_all_probes();
+DROP INDEX test_gin_contigs_idx;
+
+DROP TABLE test_gin_contigs;
+
+SELECT '--- long sequence (70 Mbp, more keys than one allocation holds) ---' AS section;
+
+CREATE TEMP TABLE test_gin_long (id int, seq dna);
+CREATE INDEX test_gin_long_idx ON test_gin_long USING gin (seq);
+
+INSERT INTO test_gin_long
+SELECT 1, repeat(string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], ''), 70)::dna
+FROM generate_series(1, 1000000);
+
+SET enable_seqscan = off;
+SELECT count(*) FROM test_gin_long
+WHERE seq @> (SELECT dna_substr(seq, 123457, 16)::text::kmer FROM test_gin_long);
+SELECT count(*) FROM test_gin_long WHERE seq @> 'ACGTACGTACGTACGTACGTACGTACGTACG'::kmer;
+RESET enable_seqscan;
+
+DROP TABLE test_gin_long;
+
+SELECT '--- DONE ---' AS section;
@@ -45,3 +45,48 @@ SELECT kmer, count(*) AS cnt
 FROM kmers
 GROUP BY kmer
 ORDER BY cnt;
+
+-- Test 4: hash functions and hash partitioning
+
+\echo 'Test hash: length matters, extended hash with seed 0 extends the plain hash'
+
+SELECT kmer_hash('AC') <> kmer_hash('ACA') AS length_hashed,
+       kmer_hash_extended('ACGT', 0) & 4294967295 = kmer_hash('ACGT')::bigint & 4294967295 AS seed0_compatible,
+       kmer_hash_extended('ACGT', 0) <> kmer_hash_extended('ACGT', 1) AS seeded;
+
+\echo 'Test hash partitioning on kmer (4 partitions)'
+
+DROP TABLE IF EXISTS kmer_parts;
+CREATE TABLE kmer_parts (kmer kmer) PARTITION BY HASH (kmer);
+CREATE TABLE kmer_parts_0 PARTITION OF kmer_parts FOR VALUES WITH (MODULUS 4, REMAINDER 0);
+CREATE TABLE kmer_parts_1 PARTITION OF kmer_parts FOR VALUES WITH (MODULUS 4, REMAINDER 1);
+CREATE TABLE kmer_parts_2 PARTITION OF kmer_parts FOR VALUES WITH (MODULUS 4, REMAINDER 2);
+CREATE TABLE kmer_parts_3 PARTITION OF kmer_parts FOR VALUES WITH (MODULUS 4, REMAINDER 3);
+
+INSERT INTO kmer_parts
+SELECT kmer FROM generate_kmers(repeat('GATTACACCGTAGGCTTAACG', 20)::dna, 6) AS kmer;
+
+-- every partition gets rows, and a lookup is pruned to one partition
+SELECT count(*) AS total,
+       count(DISTINCT tableoid) AS partitions_used
+FROM kmer_parts;
+SELECT count(*) AS hits FROM kmer_parts WHERE kmer = 'GATTAC';
+
+CREATE FUNCTION pg_temp.partitions_scanned(q text) RETURNS bigint AS $$
+DECLARE
+    line text;
+    n    bigint := 0;
+BEGIN
+    FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || q LOOP
+        IF line ~ 'Scan on kmer_parts_[0-9]' THEN
+            n := n + 1;
+        END IF;
+    END LOOP;
+    RETURN n;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT pg_temp.partitions_scanned($$SELECT count(*) FROM kmer_parts WHERE kmer = 'GATTAC'$$) AS pruned,
+       pg_temp.partitions_scanned($$SELECT count(*) FROM kmer_parts$$) AS unpruned;
+
+DROP TABLE kmer_parts;
@@ -9,7 +9,7 @@ SELECT 'acgt'::kmer;
 
 SELECT '--- Length ---' AS section;
 SELECT length('AC'::kmer);
-SELECT length('ACGTACGTACGTACGTACGTACGTACGTACGT'::kmer);
+SELECT length('ACGTACGTACGTACGTACGTACGTACGTACG'::kmer);
 
 SELECT '--- Aliases ---' AS section;
 SELECT equals('ACGT'::kmer, 'ACGT'::kmer);
@@ -17,6 +17,37 @@ SELECT equals('ACGT'::kmer, 'TGCA'::kmer);
 SELECT starts_with('AC'::kmer, 'ACGT'::kmer);  -- prefix first
 SELECT starts_with('GT'::kmer, 'ACGT'::kmer);
 
+SELECT '--- Comparison operators ---' AS section;
+SELECT 'AC'::kmer < 'ACG'::kmer;
+SELECT 'ACT'::kmer <= 'ACGT'::kmer;
+SELECT 'T'::kmer > 'GTTT'::kmer;
+SELECT 'ACGT'::kmer >= 'ACGT'::kmer;
+SELECT 'ACGT'::kmer <> 'ACGA'::kmer;
+SELECT 'ACGT'::kmer BETWEEN 'AAAA'::kmer AND 'ACGT'::kmer;
+
+SELECT '--- Hamming distance ---' AS section;
+
+SELECT 'ACGT'::kmer <-> 'ACGT'::kmer;
+SELECT 'ACGT'::kmer <-> 'AGGA'::kmer;
+SELECT 'ACGT'::kmer <-> 'ACG'::kmer;
+SELECT repeat('A', 31)::kmer <-> repeat('T', 31)::kmer;
+SELECT kmer_within('ACGTACGT'::kmer, 'ACCTACGA'::kmer, 2);
+SELECT kmer_within('ACGTACGT'::kmer, 'ACCTACGA'::kmer, 1);
+
+SELECT '--- Strands ---' AS section;
+
+SELECT kmer_revcomp('AACGTG'::kmer);
+SELECT kmer_revcomp(kmer_revcomp('GATTACA'::kmer));
+SELECT kmer_canonical('TTTG'::kmer);
+SELECT kmer_canonical('CAAA'::kmer);
+SELECT 'TTTG'::kmer ~= 'CAAA'::kmer;
+SELECT 'TTTG'::kmer ~= 'TTTG'::kmer;
+SELECT 'TTTG'::kmer ~= 'CAAT'::kmer;
+SELECT kmer_revcomp(repeat('ACG', 10)::kmer) = repeat('CGT', 10)::kmer;
+SELECT count(*)
+FROM (VALUES ('ACGT'::kmer), ('TTTG'), ('CAAA')) AS a(k)
+JOIN (VALUES ('CAAA'::kmer), ('AAAA')) AS b(k) ON a.k ~= b.k;
+
 SELECT '--- Errors ---' AS section;
 
 DO $$
@@ -30,6 +61,17 @@ BEGIN
 END;
 $$;
 
+DO $$
+BEGIN
+    BEGIN
+        PERFORM repeat('C', 32)::kmer;
+        RAISE EXCEPTION 'ERROR EXPECTED: 32 bases do not fit in one word';
+    EXCEPTION WHEN program_limit_exceeded THEN
+        -- OK: only the kmer input error, not the RAISE above
+    END;
+END;
+$$;
+
 DO $$
 BEGIN
     BEGIN
@@ -0,0 +1,158 @@
+-- Checks the kmer_counts aggregate against GROUP BY over generate_kmers
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+SELECT '--- small input ---' AS section;
+
+SELECT c.kmer, c.count
+FROM unnest((SELECT kmer_counts(s::dna, 2)
+             FROM (VALUES ('ACGTA'), ('ACA'), ('A'), (NULL)) AS v(s))) AS c;
+
+-- no rows: NULL, like array_agg
+SELECT kmer_counts(s::dna, 3) IS NULL AS empty_is_null
+FROM (VALUES ('ACGT')) AS v(s) WHERE false;
+
+\echo 'building 20 000 random reads of 150 bases'
+
+SELECT setseed(0.25);
+
+CREATE TEMP TABLE count_reads AS
+SELECT r, string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '')::dna AS seq
+FROM generate_series(1, 20000) AS r,
+LATERAL generate_series(1, 150) AS b
+GROUP BY r;
+
+ANALYZE count_reads;
+
+CREATE TEMP TABLE expected_counts AS
+SELECT k.kmer, count(*) AS count
+FROM count_reads, LATERAL generate_kmers(seq, 9) AS k(kmer)
+GROUP BY k.kmer;
+
+SELECT '--- serial ---' AS section;
+
+SET max_parallel_workers_per_gather = 0;
+
+SELECT count(*) AS mismatches
+FROM unnest((SELECT kmer_counts(seq, 9) FROM count_reads)) AS c
+FULL JOIN expected_counts AS e ON c.kmer = e.kmer
+WHERE c.count IS DISTINCT FROM e.count;
+
+-- sorted by kmer
+SELECT bool_and(a.kmer < b.kmer) AS sorted
+FROM unnest((SELECT kmer_counts(seq, 9) FROM count_reads)) WITH ORDINALITY AS a(kmer, count, i)
+JOIN unnest((SELECT kmer_counts(seq, 9) FROM count_reads)) WITH ORDINALITY AS b(kmer, count, i)
+  ON b.i = a.i + 1;
+
+SELECT '--- parallel ---' AS section;
+
+SET max_parallel_workers_per_gather = 4;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+
+DO $$
+DECLARE
+    line text;
+    p    text := '';
+BEGIN
+    FOR line IN EXPLAIN (COSTS OFF) SELECT kmer_counts(seq, 9) FROM count_reads LOOP
+        p := p || line || E'\n';
+    END LOOP;
+    IF position('Partial Aggregate' IN p) = 0 THEN
+        RAISE EXCEPTION 'expected a partial aggregate, got:%', E'\n' || p;
+    END IF;
+END;
+$$;
+
+SELECT count(*) AS mismatches
+FROM unnest((SELECT kmer_counts(seq, 9) FROM count_reads)) AS c
+FULL JOIN expected_counts AS e ON c.kmer = e.kmer
+WHERE c.count IS DISTINCT FROM e.count;
+
+RESET max_parallel_workers_per_gather;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+
+SELECT '--- bins ---' AS section;
+
+-- the bins partition the spectrum
+SELECT count(*) AS mismatches
+FROM (SELECT c.*
+      FROM generate_series(0, 7) AS bin,
+      LATERAL (SELECT kmer_counts(seq, 9, bin, 8) AS counts FROM count_reads) AS s,
+      unnest(s.counts) AS c) AS c
+FULL JOIN expected_counts AS e ON c.kmer = e.kmer
+WHERE c.count IS DISTINCT FROM e.count;
+
+SELECT '--- dense spectrum ---' AS section;
+
+SELECT c.kmer, c.count
+FROM kmer_spectrum_counts((SELECT kmer_spectrum(s::dna, 2)
+                           FROM (VALUES ('ACGTA'), ('ACA'), ('A'), (NULL)) AS v(s))) AS c;
+
+-- k, then 4^k counters
+SELECT length(kmer_spectrum('ACGT'::dna, 3)) AS bytes;
+
+CREATE TEMP TABLE expected_counts_6 AS
+SELECT k.kmer, count(*) AS count
+FROM count_reads, LATERAL generate_kmers(seq, 6) AS k(kmer)
+GROUP BY k.kmer;
+
+SET max_parallel_workers_per_gather = 4;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+
+SELECT count(*) AS mismatches
+FROM kmer_spectrum_counts((SELECT kmer_spectrum(seq, 6) FROM count_reads)) AS c
+FULL JOIN expected_counts_6 AS e ON c.kmer = e.kmer
+WHERE c.count IS DISTINCT FROM e.count;
+
+RESET max_parallel_workers_per_gather;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+
+SELECT '--- errors ---' AS section;
+
+DO $$
+BEGIN
+    BEGIN
+        PERFORM kmer_counts(s::dna, k) FROM (VALUES ('ACGT', 2), ('ACGT', 3)) AS v(s, k);
+        RAISE EXCEPTION 'ERROR EXPECTED: k differs between rows';
+    EXCEPTION WHEN invalid_parameter_value THEN
+        -- OK
+    END;
+    BEGIN
+        PERFORM kmer_counts('ACGT'::dna, 2, 4, 4);
+        RAISE EXCEPTION 'ERROR EXPECTED: bin out of range';
+    EXCEPTION WHEN invalid_parameter_value THEN
+        -- OK
+    END;
+    BEGIN
+        PERFORM kmer_counts('ACGT'::dna, 32);
+        RAISE EXCEPTION 'ERROR EXPECTED: k too large';
+    EXCEPTION WHEN program_limit_exceeded THEN
+        -- OK
+    END;
+    BEGIN
+        PERFORM kmer_spectrum('ACGT'::dna, 13);
+        RAISE EXCEPTION 'ERROR EXPECTED: k too large for a dense spectrum';
+    EXCEPTION WHEN program_limit_exceeded THEN
+        -- OK
+    END;
+    BEGIN
+        PERFORM kmer_spectrum_counts('\x00000002'::bytea);
+        RAISE EXCEPTION 'ERROR EXPECTED: truncated spectrum';
+    EXCEPTION WHEN invalid_binary_representation THEN
+        -- OK
+    END;
+END;
+$$;
+
+SELECT '--- DONE ---' AS section;
@@ -0,0 +1,66 @@
+-- Checks the planner estimates for =, ^@, <@ and @> against actual row counts
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+\echo 'building 20 600 AT-rich 21-mers, 70% starting with TTTT'
+
+SELECT setseed(0.5);
+
+CREATE TEMP TABLE kstats AS
+SELECT (CASE WHEN r % 10 < 7 THEN 'TTTT' ELSE '' END ||
+        string_agg((ARRAY['A','A','A','A','T','T','T','T','C','G'])[1 + floor(random() * 10)::int], ''))::kmer AS k
+FROM generate_series(1, 20000) AS r,
+LATERAL generate_series(1, CASE WHEN r % 10 < 7 THEN 17 ELSE 21 END) AS b
+GROUP BY r;
+
+-- one very common value
+INSERT INTO kstats SELECT 'GATTACAGATTACAGATTACA' FROM generate_series(1, 600);
+
+ANALYZE kstats;
+
+-- estimated and actual rows of a WHERE clause on kstats
+CREATE FUNCTION pg_temp.row_counts(predicate text, OUT estimated bigint, OUT actual bigint)
+LANGUAGE plpgsql AS $$
+DECLARE
+    plan json;
+BEGIN
+    EXECUTE 'EXPLAIN (FORMAT JSON) SELECT * FROM kstats WHERE ' || predicate INTO plan;
+    estimated := (plan -> 0 -> 'Plan' ->> 'Plan Rows')::bigint;
+    EXECUTE 'SELECT count(*) FROM kstats WHERE ' || predicate INTO actual;
+END;
+$$;
+
+SELECT '--- statistics ---' AS section;
+
+-- the base frequencies are stored next to the standard slots
+SELECT 10031 IN (stakind1, stakind2, stakind3, stakind4, stakind5) AS has_base_stats
+FROM pg_statistic
+WHERE starelid = 'kstats'::regclass;
+
+SELECT '--- estimates ---' AS section;
+
+-- within 3x of the actual count (without estimators ^@, <@ and @> guessed half the table)
+SELECT p AS predicate, r.estimated BETWEEN r.actual / 3.0 AND r.actual * 3.0 AS close
+FROM (VALUES ('k = ''GATTACAGATTACAGATTACA'''),
+             ('k ^@ ''T'''),
+             ('k ^@ ''TTTT'''),
+             ('k ^@ ''TTTTA'''),
+             ('k ^@ ''TTTTATTA'''),
+             ('k ^@ ''GATTACA'''),
+             ('k <@ ''NNNNNNNNNNNNNNNNNNNNN'''),
+             ('k <@ ''TTTTNNNNNNNNNNNNNNNNN'''),
+             ('k <@ ''WWWWWWWWWWWWWWWWWWWWW'''),
+             ('k <@ ''NNNNWWWWWWWWNNNNNNNNN'''),
+             ('''TTTTNNNNNNNNNNNNNNNNN''::qkmer @> k')) AS v(p),
+LATERAL pg_temp.row_counts(p) AS r;
+
+-- patterns that match nothing are estimated at a handful of rows
+SELECT p AS predicate, r.estimated <= 10 AS rare, r.actual
+FROM (VALUES ('k ^@ ''CCGCCGCCG'''),
+             ('k <@ ''SSSSSSSSSSSSSSSSSSSSS''')) AS v(p),
+LATERAL pg_temp.row_counts(p) AS r;
+
+SELECT '--- DONE ---' AS section;
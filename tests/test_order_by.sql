@@ -45,3 +45,16 @@ FROM (VALUES
     ('ACT'::kmer)
 ) AS v(kmer)
 ORDER BY v.kmer DESC;
+
+-- Test 4: sort order on mixed lengths matches byte order of the text form
+
+\echo 'Test ORDER BY kmer agrees with text order (mixed lengths, sortsupport)'
+
+WITH kmers AS (
+    SELECT k.kmer
+    FROM generate_series(1, 8) AS len,
+         LATERAL generate_kmers(repeat('ACGTTGCAAAC', 20)::dna, len) AS k(kmer)
+)
+SELECT (SELECT array_agg(kmer::text ORDER BY kmer) FROM kmers)
+     = (SELECT array_agg(kmer::text ORDER BY kmer::text COLLATE "C") FROM kmers)
+       AS same_order;
@@ -0,0 +1,109 @@
+-- Tests that queries over kmer can use parallel plans
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+\echo 'building a 2 000 000 row kmer table (k=12)'
+
+DROP TABLE IF EXISTS test_parallel_kmers;
+CREATE TABLE test_parallel_kmers (
+    kmer_value  kmer NOT NULL
+);
+
+INSERT INTO test_parallel_kmers (kmer_value)
+SELECT k.kmer
+FROM (
+    SELECT string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '')::dna AS seq
+    FROM generate_series(1, 2000011)
+) AS s,
+LATERAL generate_kmers(s.seq, 12) AS k(kmer);
+
+ANALYZE test_parallel_kmers;
+
+-- make parallel plans attractive regardless of table size / machine
+SET max_parallel_workers_per_gather = 4;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET enable_sort = off;
+
+-- Returns the EXPLAIN output of a query as one text value
+CREATE FUNCTION pg_temp.plan_of(q text) RETURNS text AS $$
+DECLARE
+    line text;
+    res  text := '';
+BEGIN
+    FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || q LOOP
+        res := res || line || E'\n';
+    END LOOP;
+    RETURN res;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT '--- parallel seq scan with kmer filters ---' AS section;
+
+DO $$
+DECLARE
+    p text;
+BEGIN
+    p := pg_temp.plan_of($q$SELECT count(*) FROM test_parallel_kmers
+                           WHERE kmer_value ^@ 'ACG'::kmer$q$);
+    IF position('Parallel Seq Scan' IN p) = 0 THEN
+        RAISE EXCEPTION 'expected a parallel seq scan for ^@, got:%', E'\n' || p;
+    END IF;
+
+    p := pg_temp.plan_of($q$SELECT count(*) FROM test_parallel_kmers
+                           WHERE kmer_value <@ 'ACGTNNNNNNNN'::qkmer$q$);
+    IF position('Parallel Seq Scan' IN p) = 0 THEN
+        RAISE EXCEPTION 'expected a parallel seq scan for <@, got:%', E'\n' || p;
+    END IF;
+
+    p := pg_temp.plan_of($q$SELECT count(*) FROM test_parallel_kmers
+                           WHERE kmer_value BETWEEN 'AAAA'::kmer AND 'ACGT'::kmer$q$);
+    IF position('Parallel Seq Scan' IN p) = 0 THEN
+        RAISE EXCEPTION 'expected a parallel seq scan for BETWEEN, got:%', E'\n' || p;
+    END IF;
+END;
+$$;
+
+SELECT '--- parallel hash aggregate ---' AS section;
+
+DO $$
+DECLARE
+    p text;
+BEGIN
+    p := pg_temp.plan_of($q$SELECT kmer_value, count(*) FROM test_parallel_kmers
+                           GROUP BY kmer_value$q$);
+    IF position('Partial HashAggregate' IN p) = 0
+       OR position('Parallel Seq Scan' IN p) = 0 THEN
+        RAISE EXCEPTION 'expected a partial hash aggregate over a parallel scan, got:%',
+                        E'\n' || p;
+    END IF;
+END;
+$$;
+
+SELECT '--- parallel and serial results agree ---' AS section;
+
+CREATE TEMP TABLE parallel_counts AS
+SELECT kmer_value, count(*) AS cnt FROM test_parallel_kmers GROUP BY kmer_value;
+
+SET max_parallel_workers_per_gather = 0;
+
+SELECT count(*) AS mismatches
+FROM parallel_counts p
+FULL JOIN (SELECT kmer_value, count(*) AS cnt
+           FROM test_parallel_kmers GROUP BY kmer_value) s
+       ON p.kmer_value = s.kmer_value
+WHERE p.cnt IS DISTINCT FROM s.cnt;
+
+RESET max_parallel_workers_per_gather;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET enable_sort;
+
+DROP TABLE test_parallel_kmers;
+
+SELECT '--- DONE ---' AS section;
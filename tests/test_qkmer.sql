@@ -21,6 +21,20 @@ SELECT '--- Operator literal casting ---' AS section;
 SELECT 'ANGTA' @> 'ATGTA'::kmer;
 SELECT 'ANGTA' @> 'ACGTA'::kmer;
 
+SELECT '--- Base sets ---' AS section;
+-- bases accepted by each IUPAC code
+SELECT q, string_agg(b, '' ORDER BY b) FILTER (WHERE q::qkmer @> b::kmer) AS accepts
+FROM unnest(string_to_array('A,C,G,T,N,R,Y,S,W,K,M,B,D,H,V', ',')) AS q,
+     unnest(ARRAY['A', 'C', 'G', 'T']) AS b
+GROUP BY q
+ORDER BY q;
+
+-- positions on both sides of the 16th
+SELECT (repeat('N', 16) || 'R' || repeat('N', 14))::qkmer @> (repeat('A', 16) || 'G' || repeat('A', 14))::kmer;
+SELECT (repeat('N', 16) || 'R' || repeat('N', 14))::qkmer @> (repeat('A', 16) || 'C' || repeat('A', 14))::kmer;
+SELECT (repeat('N', 15) || 'Y' || repeat('N', 15))::qkmer @> (repeat('A', 15) || 'T' || repeat('A', 15))::kmer;
+SELECT (repeat('N', 15) || 'Y' || repeat('N', 15))::qkmer @> (repeat('A', 15) || 'G' || repeat('A', 15))::kmer;
+
 SELECT '--- Errors ---' AS section;
 
 DO $$
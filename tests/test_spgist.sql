@@ -60,6 +60,16 @@ FROM test_kmers
 WHERE kmer_value = 'AAAAAAAAAA'::kmer;
 
 
+\echo '--- test 1C : compteurs de parcours spgist (pg_dna.track_scan_stats) ---'
+SET pg_dna.track_scan_stats = on;
+SELECT * FROM pg_dna_scan_stats(true);
+SELECT count(*)
+FROM test_kmers
+WHERE kmer_value = 'AAAAAAAAAA'::kmer;
+SELECT * FROM pg_dna_scan_stats(true);
+RESET pg_dna.track_scan_stats;
+
+
 \echo '==== test 2 : prefix (^@) tres selectif ===='
 \echo 'prefix utilise : AAAAAAAC (8 chars)'
 
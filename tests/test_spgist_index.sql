@@ -0,0 +1,218 @@
+-- Checks that SP-GiST index scans return the same rows as sequential scans
+
+SET client_min_messages = WARNING;
+
+DROP EXTENSION IF EXISTS pg_dna CASCADE;
+CREATE EXTENSION pg_dna;
+
+\echo 'building a kmer table with mixed lengths (4..20) and many duplicates'
+
+SELECT setseed(0.5);
+
+DROP TABLE IF EXISTS test_spgist_kmers;
+CREATE TABLE test_spgist_kmers (
+    kmer_value  kmer NOT NULL
+);
+
+INSERT INTO test_spgist_kmers (kmer_value)
+SELECT k.kmer
+FROM (
+    SELECT string_agg((ARRAY['A','C','G','T'])[1 + floor(random() * 4)::int], '')::dna AS seq
+    FROM generate_series(1, 20000)
+) AS s,
+LATERAL generate_series(4, 20) AS len,
+LATERAL generate_kmers(s.seq, len) AS k(kmer);
+
+-- a heavily duplicated value
+INSERT INTO test_spgist_kmers
+SELECT 'ACGTACGTAC'::kmer FROM generate_series(1, 5000);
+
+CREATE INDEX test_spgist_kmers_idx ON test_spgist_kmers USING spgist (kmer_value);
+VACUUM ANALYZE test_spgist_kmers;
+
+-- <@ raises an error when the pattern and kmer lengths differ, so its probes
+-- run over a table of 7-mers only
+DROP TABLE IF EXISTS test_spgist_kmers7;
+CREATE TABLE test_spgist_kmers7 (
+    kmer_value  kmer NOT NULL
+);
+
+INSERT INTO test_spgist_kmers7
+SELECT kmer_value FROM test_spgist_kmers WHERE length(kmer_value) = 7;
+
+INSERT INTO test_spgist_kmers7
+SELECT 'GATTACA'::kmer FROM generate_series(1, 2000);
+
+CREATE INDEX test_spgist_kmers7_idx ON test_spgist_kmers7 USING spgist (kmer_value);
+VACUUM ANALYZE test_spgist_kmers7;
+
+-- Runs q under a seq scan and under an index scan and compares the results
+CREATE FUNCTION pg_temp.check_index(q text, scan text) RETURNS void AS $$
+DECLARE
+    plan      text := '';
+    line      text;
+    seq_res   text;
+    index_res text;
+BEGIN
+    PERFORM set_config('enable_seqscan', 'on', true);
+    PERFORM set_config('enable_indexscan', 'off', true);
+    PERFORM set_config('enable_indexonlyscan', 'off', true);
+    PERFORM set_config('enable_bitmapscan', 'off', true);
+    EXECUTE q INTO seq_res;
+
+    PERFORM set_config('enable_seqscan', 'off', true);
+    PERFORM set_config('enable_indexscan', 'on', true);
+    PERFORM set_config('enable_indexonlyscan', 'on', true);
+    FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || q LOOP
+        plan := plan || line || E'\n';
+    END LOOP;
+    IF position(scan IN plan) = 0 THEN
+        RAISE EXCEPTION 'expected % for %, got:%', scan, q, E'\n' || plan;
+    END IF;
+    EXECUTE q INTO index_res;
+
+    IF seq_res IS DISTINCT FROM index_res THEN
+        RAISE EXCEPTION 'index scan and seq scan disagree for %', q;
+    END IF;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT '--- = ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers WHERE kmer_value = %L::kmer', v),
+           'Index Only Scan')
+FROM (VALUES ('ACGTACGTAC'), ('ACGT'), ('TTTTTTTTTTTTTTTTTTTT'), ('GATTACA')) AS q(v);
+
+SELECT '--- ~= (either strand) ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers WHERE kmer_value ~= %L::kmer', v),
+           'Index Only Scan')
+FROM (VALUES ('GTACGTACGT'), ('ACGT'), ('AAAAAAAAAAAAAAAAAAAA'), ('TGTAATC')) AS q(v);
+
+SELECT '--- ^@ ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers WHERE kmer_value ^@ %L::kmer', v),
+           'Index Only Scan')
+FROM (VALUES ('A'), ('GA'), ('TTT'), ('ACGT')) AS q(v);
+
+SELECT '--- <@ ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers7 WHERE kmer_value <@ %L::qkmer', v),
+           'Index Only Scan')
+FROM (VALUES ('ACGNNNN'), ('NNNNNNN'), ('GATTNCA'), ('RYNNNNN'), ('GATTACA')) AS q(v);
+
+SELECT '--- <, <=, >, >= ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers WHERE kmer_value %s %L::kmer', op, v),
+           'Index Only Scan')
+FROM (VALUES ('<'), ('<='), ('>'), ('>=')) AS o(op),
+     (VALUES ('ACGTACGTAC'), ('ACGTACGTA'), ('GGGG'), ('C'), ('TTTTTTTTTTTTTTTTTTTT')) AS q(v);
+
+SELECT pg_temp.check_index(
+           $$SELECT md5(string_agg(kmer_value::text, ',' ORDER BY kmer_value))
+             FROM test_spgist_kmers WHERE kmer_value BETWEEN 'ACG'::kmer AND 'ACT'::kmer$$,
+           'Index Only Scan');
+
+SELECT pg_temp.check_index(
+           $$SELECT count(*)::text FROM test_spgist_kmers7
+             WHERE kmer_value > 'GAT'::kmer AND kmer_value <= 'GATTACA'::kmer
+               AND kmer_value <@ 'NNNNNNN'::qkmer$$,
+           'Index Only Scan');
+
+SELECT '--- nearest neighbours: ORDER BY <-> ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT string_agg(d::text, '','') FROM
+              (SELECT kmer_value <-> %1$L::kmer AS d FROM test_spgist_kmers
+               ORDER BY kmer_value <-> %1$L::kmer LIMIT 50) s', v),
+           'Index Only Scan')
+FROM (VALUES ('ACGTACGTAC'), ('GATTACAGATTACA'), ('TTTT'), ('ACGTTGCAACGTTGCAACGT')) AS q(v);
+
+SELECT pg_temp.check_index(
+           $$SELECT count(*)::text FROM
+               (SELECT kmer_value FROM test_spgist_kmers
+                WHERE kmer_value ^@ 'GA'::kmer
+                ORDER BY kmer_value <-> 'GATTACAGA'::kmer LIMIT 20) s
+             WHERE kmer_within(kmer_value, 'GATTACAGA'::kmer, 3)$$,
+           'Index Only Scan');
+
+SELECT '--- several predicates at once ---' AS section;
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers WHERE kmer_value %s', v),
+           'Index Only Scan')
+FROM (VALUES ($$^@ 'AC'::kmer AND kmer_value = 'ACGTACGTAC'::kmer$$),
+             ($$^@ 'GA'::kmer AND kmer_value ^@ 'GAT'::kmer AND kmer_value = 'GATTACA'::kmer$$)) AS q(v);
+
+SELECT pg_temp.check_index(format(
+           'SELECT count(*)::text FROM test_spgist_kmers7 WHERE kmer_value %s', v),
+           'Index Only Scan')
+FROM (VALUES ($$^@ 'ACG'::kmer AND kmer_value <@ 'NNNRYNN'::qkmer$$),
+             ($$<@ 'NNNRYNN'::qkmer AND kmer_value ^@ 'ACG'::kmer$$),
+             ($$^@ 'GA'::kmer AND kmer_value ^@ 'GAT'::kmer AND kmer_value <@ 'NNNNNNN'::qkmer$$)) AS q(v);
+
+SELECT '--- index-only scans return the full kmers ---' AS section;
+
+SELECT pg_temp.check_index(
+           'SELECT md5(string_agg(kmer_value::text, '','' ORDER BY kmer_value::text))
+            FROM test_spgist_kmers WHERE kmer_value ^@ ''GA''::kmer',
+           'Index Only Scan');
+
+SELECT pg_temp.check_index(
+           'SELECT md5(string_agg(kmer_value::text, '','' ORDER BY kmer_value::text))
+            FROM test_spgist_kmers7 WHERE kmer_value <@ ''NNNRNNN''::qkmer',
+           'Index Only Scan');
+
+SELECT '--- scan counters (pg_dna.track_scan_stats) ---' AS section;
+
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SET max_parallel_workers_per_gather = 0;
+
+DO $$
+DECLARE
+    s record;
+    n bigint;
+BEGIN
+    PERFORM pg_dna_scan_stats(true);
+
+    -- off (the default): scans leave the counters alone
+    PERFORM set_config('pg_dna.track_scan_stats', 'off', true);
+    SELECT count(*) INTO n FROM test_spgist_kmers WHERE kmer_value ^@ 'ACG'::kmer;
+    SELECT * INTO s FROM pg_dna_scan_stats();
+    IF s.inner_visited <> 0 OR s.nodes_descended <> 0 OR s.nodes_pruned <> 0
+       OR s.leaves_tested <> 0 OR s.leaves_matched <> 0 THEN
+        RAISE EXCEPTION 'counters moved while tracking was off: %', s;
+    END IF;
+
+    -- on: every row the scan returns is a matched leaf
+    PERFORM set_config('pg_dna.track_scan_stats', 'on', true);
+    SELECT count(*) INTO n FROM test_spgist_kmers WHERE kmer_value ^@ 'ACG'::kmer;
+    SELECT * INTO s FROM pg_dna_scan_stats(true);
+    IF s.leaves_tested <= 0 OR s.leaves_matched <> n OR s.inner_visited <= 0 THEN
+        RAISE EXCEPTION 'unexpected counters for % rows: %', n, s;
+    END IF;
+
+    -- the reset above cleared them
+    PERFORM set_config('pg_dna.track_scan_stats', 'off', true);
+    SELECT * INTO s FROM pg_dna_scan_stats();
+    IF s.inner_visited <> 0 OR s.nodes_descended <> 0 OR s.nodes_pruned <> 0
+       OR s.leaves_tested <> 0 OR s.leaves_matched <> 0 THEN
+        RAISE EXCEPTION 'counters not reset: %', s;
+    END IF;
+END;
+$$;
+
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+RESET max_parallel_workers_per_gather;
+
+DROP TABLE test_spgist_kmers;
+DROP TABLE test_spgist_kmers7;
+
+SELECT '--- DONE ---' AS section;